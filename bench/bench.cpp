@@ -0,0 +1,468 @@
+#include "mock_engine.h"
+#include "sendprop_finder.h"
+#include "sendprop_hookmanager.h"
+#include "clientpacks_detours.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Set up by extension.cpp in the game, from the gamedata and the engine interfaces
+static SendPropHookManager s_SendPropHookManager;
+SendPropHookManager *g_pSendPropHookManager = &s_SendPropHookManager;
+
+IServerGameEnts *gameents = nullptr;
+ISDKTools *sdktools = nullptr;
+CGlobalVars *gpGlobals = nullptr;
+ConVar *sv_parallel_packentities = nullptr;
+
+CFrameSnapshotManager *framesnapshotmanager = nullptr;
+void *CFrameSnapshotManager::s_pfnCreateEmptySnapshot = nullptr;
+ICallWrapper *CFrameSnapshotManager::s_callCreateEmptySnapshot = nullptr;
+void *CFrameSnapshotManager::s_pfnRemoveEntityReference = nullptr;
+ICallWrapper *CFrameSnapshotManager::s_callRemoveEntityReference = nullptr;
+void *CFrameSnapshot::s_pfnReleaseReference = nullptr;
+ICallWrapper *CFrameSnapshot::s_callReleaseReference = nullptr;
+
+void **g_ppLocalNetworkBackdoor = nullptr;
+
+CBaseEntity *GetGameRulesProxyEnt()
+{
+	return nullptr;
+}
+
+struct BenchOptions
+{
+	MockServerConfig server;
+	int hooked{64};			// hooked entities, right after the players
+	int hookedProps{4};		// hooked props of each of them
+	int groups{2};			// distinct overrides among the clients
+	int flags{0};			// SendProxyFlags of the hooks
+	int ticks{500};
+	int iterations{200};
+	bool stats{false};
+};
+
+static volatile int s_iSink;
+
+template <typename Fn>
+static double MeasureNs(int count, Fn &&fn)
+{
+	const auto start = std::chrono::steady_clock::now();
+	fn();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / std::max(count, 1);
+}
+
+static void Report(const char *name, double ns, const char *unit = "ns/op")
+{
+	printf("  %-44s %12.1f %s\n", name, ns, unit);
+}
+
+static int FirstHookedEntity()
+{
+	return g_MockServer.GetNumClients() + 1;
+}
+
+static int HookAll(const BenchOptions &options, BenchPluginFunction *pCallback)
+{
+	int count = 0;
+	for (int e = 0; e < options.hooked; ++e)
+	{
+		for (int p = 0; p < options.hookedProps; ++p)
+		{
+			count += g_pSendPropHookManager->HookEntity(FirstHookedEntity() + e, g_MockServer.GetProp(p), g_MockServer.GetPropOffset(p),
+				0, PropType::Prop_Int, &SendProxyPluginCallback, pCallback, nullptr, 0, options.flags);
+		}
+	}
+	return count;
+}
+
+static void UnhookAll(const BenchOptions &options, BenchPluginFunction *pCallback)
+{
+	for (int e = 0; e < options.hooked; ++e)
+	{
+		for (int p = 0; p < options.hookedProps; ++p)
+			g_pSendPropHookManager->UnhookEntity(FirstHookedEntity() + e, g_MockServer.GetProp(p), 0, pCallback);
+	}
+}
+
+static void BenchHookUnhook(const BenchOptions &options, BenchPluginFunction *pCallback)
+{
+	const int rounds = std::max(options.iterations / 10, 1);
+	const int count = options.hooked * options.hookedProps;
+	double hookNs = 0.0;
+	double unhookNs = 0.0;
+
+	for (int round = 0; round < rounds; ++round)
+	{
+		hookNs += MeasureNs(count, [&] { HookAll(options, pCallback); });
+		unhookNs += MeasureNs(count, [&] { UnhookAll(options, pCallback); });
+	}
+
+	printf("Hooks (%d entities x %d props):\n", options.hooked, options.hookedProps);
+	Report("HookEntity", hookNs / rounds);
+	Report("UnhookEntity", unhookNs / rounds);
+}
+
+static double MeasureTicks(const BenchOptions &options)
+{
+	for (int i = 0; i < options.ticks / 10; ++i)
+		g_MockServer.RunTick();
+
+	return MeasureNs(options.ticks, [&]
+		{
+			for (int i = 0; i < options.ticks; ++i)
+				g_MockServer.RunTick();
+		});
+}
+
+// Calls the proxy of the hooked props for the hooked entities as the encoder does
+static double MeasureProxy(const BenchOptions &options, int slot, int objectID)
+{
+	const int count = options.iterations * 1000;
+	g_iCurrentClientIndexInLoop = slot;
+
+	const double ns = MeasureNs(count, [&]
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				const SendProp *pProp = g_MockServer.GetProp(i % options.hookedProps);
+				const int entity = objectID != -1 ? objectID : FirstHookedEntity() + i % options.hooked;
+				const BenchEntity *pEntity = g_MockServer.GetEntity(entity);
+
+				DVariant out;
+				pProp->GetProxyFn()(pProp, pEntity, reinterpret_cast<const uint8_t *>(pEntity) + pProp->GetOffset(), &out, 0, entity);
+				s_iSink = out.m_Int;
+			}
+		});
+
+	g_iCurrentClientIndexInLoop = -1;
+	return ns;
+}
+
+static void BenchProxyDispatch(const BenchOptions &options)
+{
+	// Original proxy as the encoder calls it, through the prop's pointer
+	static SendVarProxyFn volatile s_pfnOriginal = &SendProxy_Int32ToInt32;
+	const int count = options.iterations * 1000;
+	const double originalNs = MeasureNs(count, [&]
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				const SendProp *pProp = g_MockServer.GetProp(i % options.hookedProps);
+				const BenchEntity *pEntity = g_MockServer.GetEntity(FirstHookedEntity() + i % options.hooked);
+
+				DVariant out;
+				s_pfnOriginal(pProp, pEntity, reinterpret_cast<const uint8_t *>(pEntity) + pProp->GetOffset(), &out, 0, 0);
+				s_iSink = out.m_Int;
+			}
+		});
+
+	// Overrides of the first client, as its pass would see them. The second one has none.
+	g_pSendPropHookManager->LockDispatch();
+	for (int e = 0; e < options.hooked; ++e)
+	{
+		g_pSendPropHookManager->MarkEntityDirty(FirstHookedEntity() + e);
+		g_pSendPropHookManager->EvaluateEntity(FirstHookedEntity() + e, 1);
+	}
+	g_pSendPropHookManager->UnlockDispatch();
+
+	printf("Proxy dispatch:\n");
+	Report("original proxy", originalNs);
+	Report("GlobalProxy, override applied", MeasureProxy(options, 0, -1));
+
+	// Nothing to apply, GlobalProxy ends up calling the original proxy with the engine's data
+	printf("Proxy dispatch, no match:\n");
+	Report("outside the client passes", MeasureProxy(options, -1, -1));
+	Report("entity not hooked", MeasureProxy(options, 0, 0));
+	Report("hooked entity, not overridden for the client", MeasureProxy(options, 1, -1));
+}
+
+static void BenchEvaluateEntity(const BenchOptions &options)
+{
+	const int count = options.hooked * options.server.clients;
+
+	auto evaluate = [&](bool dirty)
+	{
+		double ns = 0.0;
+		for (int i = 0; i < options.iterations; ++i)
+		{
+			g_pSendPropHookManager->LockDispatch();
+			if (dirty)
+			{
+				for (int e = 0; e < options.hooked; ++e)
+					g_pSendPropHookManager->MarkEntityDirty(FirstHookedEntity() + e);
+			}
+
+			ns += MeasureNs(count, [&]
+				{
+					for (int client = 1; client <= options.server.clients; ++client)
+					{
+						for (int e = 0; e < options.hooked; ++e)
+							s_iSink = g_pSendPropHookManager->EvaluateEntity(FirstHookedEntity() + e, client);
+					}
+				});
+			g_pSendPropHookManager->UnlockDispatch();
+		}
+		return ns / options.iterations;
+	};
+
+	printf("EvaluateEntity (%d entities x %d clients):\n", options.hooked, options.server.clients);
+	Report("marked dirty", evaluate(true));
+	Report("unchanged (early out if value-driven)", evaluate(false));
+}
+
+// Offsets the hooks read props at, against the data the engine hands to their proxy
+static bool CheckPropOffsets()
+{
+	struct
+	{
+		const char *name;
+		int element;
+		bool gamerules;
+		bool rejected;		// the data is not at an offset of the object read from
+	} cases[] = {
+		{ "m_iLocal", 0, false, false },
+		{ "m_iArray", 2, false, false },
+		{ "m_iShared", 0, false, true },
+		{ "m_iShared", 0, true, false },
+	};
+
+	BenchNestedEntity *pEntity = g_MockServer.GetNestedEntity();
+	const std::vector<BenchEncodedProp> encoded = g_MockServer.EncodeNestedEntity();
+	bool ok = true;
+
+	printf("Prop offsets, against the data given to the proxy (%s):\n", g_MockServer.GetNestedServerClass()->GetName());
+	for (const auto &test : cases)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%s[%d]%s", test.name, test.element, test.gamerules ? ", as a game rules prop" : "");
+
+		SendProp *pProp = nullptr;
+		int offset = 0;
+		char error[256];
+		if (!UTIL_FindClassSendProp(pProp, g_MockServer.GetNestedServerClass(), test.name, true, PropType::Prop_Int, test.element, &offset,
+			error, sizeof(error), test.gamerules))
+		{
+			printf("  %-44s %12s (%s)\n", name, "rejected", error);
+			ok &= test.rejected;
+			continue;
+		}
+
+		// What EvaluateEntity reads, from the game rules object for game rules hooks
+		const uint8_t *pBase = test.gamerules ? reinterpret_cast<const uint8_t *>(pEntity->m_pShared) : reinterpret_cast<const uint8_t *>(pEntity);
+		const void *pRead = pBase + offset;
+
+		auto it = std::find_if(encoded.begin(), encoded.end(), [&](const BenchEncodedProp &prop)
+			{ return prop.pProp == pProp && prop.element == test.element; });
+
+		const bool match = !test.rejected && it != encoded.end() && it->pData == pRead
+			&& *static_cast<const int *>(it->pData) == *static_cast<const int *>(pRead);
+		printf("  %-44s %12s\n", name, match ? "ok" : "MISMATCH");
+		ok &= match;
+	}
+
+	return ok;
+}
+
+// What SV_ComputeClientPacks forced linear packing with before ConVarScopedInt.
+// The mock ConVar has no change callbacks, so this is a lower bound of its cost in the game.
+class ConVarScopedSet
+{
+public:
+	explicit ConVarScopedSet(ConVar *cvar, const char *value)
+		: m_cvar(cvar), m_savevalue(m_cvar->GetString())
+	{
+		m_cvar->SetValue(value);
+	}
+
+	ConVarScopedSet() = delete;
+	ConVarScopedSet(const ConVarScopedSet &other) = delete;
+
+	~ConVarScopedSet()
+	{
+		m_cvar->SetValue(m_savevalue.data());
+	}
+
+private:
+	ConVar *m_cvar;
+	std::string m_savevalue;
+};
+
+static void BenchConVarScope(const BenchOptions &options)
+{
+	const int count = options.iterations * 1000;
+
+	const double scopedIntNs = MeasureNs(count, [&]
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				ConVarScopedInt linearpack(sv_parallel_packentities, 0);
+				s_iSink = sv_parallel_packentities->GetInt();
+			}
+		});
+
+	const double scopedSetNs = MeasureNs(count, [&]
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				ConVarScopedSet linearpack(sv_parallel_packentities, "0");
+				s_iSink = sv_parallel_packentities->GetInt();
+			}
+		});
+
+	printf("Linear packing scope, once per hooked tick (sv_parallel_packentities):\n");
+	Report("ConVarScopedInt", scopedIntNs);
+	Report("ConVarScopedSet, string round trip", scopedSetNs);
+}
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!strcmp(arg, "--help"))
+			return false;
+
+		if (!strcmp(arg, "--stats"))
+		{
+			options.stats = true;
+			continue;
+		}
+
+		if (value == nullptr)
+		{
+			fprintf(stderr, "Missing value for %s\n", arg);
+			return false;
+		}
+		++i;
+
+		if (!strcmp(arg, "--entities"))
+			options.server.entities = atoi(value);
+		else if (!strcmp(arg, "--clients"))
+			options.server.clients = atoi(value);
+		else if (!strcmp(arg, "--props"))
+			options.server.props = atoi(value);
+		else if (!strcmp(arg, "--visible"))
+			options.server.visible = static_cast<float>(atof(value));
+		else if (!strcmp(arg, "--changed"))
+			options.server.changed = static_cast<float>(atof(value));
+		else if (!strcmp(arg, "--hooked"))
+			options.hooked = atoi(value);
+		else if (!strcmp(arg, "--hooked-props"))
+			options.hookedProps = atoi(value);
+		else if (!strcmp(arg, "--groups"))
+			options.groups = atoi(value);
+		else if (!strcmp(arg, "--ticks"))
+			options.ticks = atoi(value);
+		else if (!strcmp(arg, "--iterations"))
+			options.iterations = atoi(value);
+		else if (!strcmp(arg, "--flags"))
+		{
+			if (!strcmp(value, "none"))
+				options.flags = 0;
+			else if (!strcmp(value, "invariant"))
+				options.flags = SendProxyFlag_ClientInvariant;
+			else if (!strcmp(value, "value-driven"))
+				options.flags = SendProxyFlag_ValueDriven;
+			else if (!strcmp(value, "both"))
+				options.flags = SendProxyFlag_ClientInvariant | SendProxyFlag_ValueDriven;
+			else
+			{
+				fprintf(stderr, "Unknown flags %s (none, invariant, value-driven, both)\n", value);
+				return false;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", arg);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void PrintUsage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --entities N       edicts, world and players included (512)\n"
+		"  --clients N        clients, between 2 and %d (16)\n"
+		"  --props N          int props of each entity, up to %d (16)\n"
+		"  --visible F        fraction of the entities each client transmits (0.7)\n"
+		"  --changed F        fraction of the entities changing each tick (0.1)\n"
+		"  --hooked N         hooked entities (64)\n"
+		"  --hooked-props N   hooked props of each hooked entity (4)\n"
+		"  --groups N         distinct overrides among the clients, 0 for none (2)\n"
+		"  --flags F          none, invariant, value-driven or both (none)\n"
+		"  --ticks N          packed ticks (500)\n"
+		"  --iterations N     repetitions of the other measures (200)\n"
+		"  --stats            print sm_sendproxy_stats afterwards\n",
+		name, MAXPLAYERS, MAX_BENCH_PROPS);
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	options.server.clients = std::clamp(options.server.clients, 2, MAXPLAYERS);
+	options.server.props = std::clamp(options.server.props, 1, MAX_BENCH_PROPS);
+	options.hookedProps = std::clamp(options.hookedProps, 1, options.server.props);
+	options.server.entities = std::clamp(options.server.entities, options.server.clients + 2, MAX_EDICTS);
+	options.hooked = std::clamp(options.hooked, 1, options.server.entities - options.server.clients - 1);
+	options.ticks = std::max(options.ticks, 1);
+	options.iterations = std::max(options.iterations, 1);
+
+	g_MockServer.Init(options.server);
+	if (!ClientPacksDetour::Init(nullptr))
+	{
+		fprintf(stderr, "Could not set up the detours\n");
+		return 1;
+	}
+
+	printf("%d entities, %d clients, %d props, %.0f%% visible, %.0f%% changing each tick\n",
+		options.server.entities, options.server.clients, options.server.props,
+		options.server.visible * 100.0f, options.server.changed * 100.0f);
+
+	const bool offsetsOk = CheckPropOffsets();
+
+	BenchPluginFunction callback(options.groups);
+	BenchHookUnhook(options, &callback);
+
+	const double unhookedTickNs = MeasureTicks(options);
+
+	HookAll(options, &callback);
+	BenchProxyDispatch(options);
+	BenchEvaluateEntity(options);
+
+	printf("Client packs (%d ticks):\n", options.ticks);
+	Report("SV_ComputeClientPacks, nothing hooked", unhookedTickNs / 1000.0, "us/tick");
+	Report("SV_ComputeClientPacks, hooked", MeasureTicks(options) / 1000.0, "us/tick");
+
+	BenchConVarScope(options);
+
+	if (options.stats)
+	{
+		const char *args[] = { "sm_sendproxy_stats" };
+		ConCommand::Find("sm_sendproxy_stats")->Dispatch(CCommand(1, args));
+	}
+
+	for (int entity = 0; entity < g_MockServer.GetNumEntities(); ++entity)
+		g_pSendPropHookManager->UnhookEntityAll(entity);
+	for (int client = 1; client <= g_MockServer.GetNumClients(); ++client)
+		ClientPacksDetour::OnClientDisconnected(client);
+	g_pSendPropHookManager->Clear();
+
+	ClientPacksDetour::Shutdown();
+	g_MockServer.Shutdown();
+	return offsetsOk ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#ifndef _BENCH_DETOURS_H
+#define _BENCH_DETOURS_H
+
+#include "../bench_sdk.h"
+
+// Same declaration macros as SourceMod's CDetour. Instead of patching code, a detour
+// swaps the function the mock engine calls through, found by its gamedata name.
+
+class GenericClass {};
+typedef void (GenericClass::*VoidFunc)();
+
+inline void *GetCodeAddr(VoidFunc mfp)
+{
+	return *reinterpret_cast<void **>(&mfp);
+}
+
+#define GetCodeAddress(mfp) GetCodeAddr(reinterpret_cast<VoidFunc>(mfp))
+
+#define DETOUR_MEMBER_CALL(name) (this->*name##_Actual)
+#define DETOUR_STATIC_CALL(name) (name##_Actual)
+
+#define DETOUR_DECL_STATIC1(name, ret, p1type, p1name) \
+ret (*name##_Actual)(p1type) = NULL; \
+ret name(p1type p1name)
+
+#define DETOUR_DECL_STATIC3(name, ret, p1type, p1name, p2type, p2name, p3type, p3name) \
+ret (*name##_Actual)(p1type, p2type, p3type) = NULL; \
+ret name(p1type p1name, p2type p2name, p3type p3name)
+
+#define DETOUR_DECL_MEMBER0(name, ret) \
+class name##Class \
+{ \
+public: \
+	ret name(); \
+	static ret (name##Class::* name##_Actual)(void); \
+}; \
+ret (name##Class::* name##Class::name##_Actual)(void) = NULL; \
+ret name##Class::name()
+
+#define DETOUR_DECL_MEMBER2(name, ret, p1type, p1name, p2type, p2name) \
+class name##Class \
+{ \
+public: \
+	ret name(p1type p1name, p2type p2name); \
+	static ret (name##Class::* name##_Actual)(p1type, p2type); \
+}; \
+ret (name##Class::* name##Class::name##_Actual)(p1type, p2type) = NULL; \
+ret name##Class::name(p1type p1name, p2type p2name)
+
+#define DETOUR_DECL_MEMBER3(name, ret, p1type, p1name, p2type, p2name, p3type, p3name) \
+class name##Class \
+{ \
+public: \
+	ret name(p1type p1name, p2type p2name, p3type p3name); \
+	static ret (name##Class::* name##_Actual)(p1type, p2type, p3type); \
+}; \
+ret (name##Class::* name##Class::name##_Actual)(p1type, p2type, p3type) = NULL; \
+ret name##Class::name(p1type p1name, p2type p2name, p3type p3name)
+
+#define GET_MEMBER_CALLBACK(name) (void *)GetCodeAddress(&name##Class::name)
+#define GET_MEMBER_TRAMPOLINE(name) (void **)(&name##Class::name##_Actual)
+
+#define GET_STATIC_CALLBACK(name) (void *)&name
+#define GET_STATIC_TRAMPOLINE(name) (void **)&name##_Actual
+
+#define DETOUR_CREATE_MEMBER(name, gamedata) CDetourManager::CreateDetour(GET_MEMBER_CALLBACK(name), GET_MEMBER_TRAMPOLINE(name), gamedata);
+#define DETOUR_CREATE_STATIC(name, gamedata) CDetourManager::CreateDetour(GET_STATIC_CALLBACK(name), GET_STATIC_TRAMPOLINE(name), gamedata);
+
+class CDetour
+{
+public:
+	CDetour(void *callbackfunction, void **pTarget, void *pOriginal)
+		: m_pCallback(callbackfunction), m_pTarget(pTarget), m_pOriginal(pOriginal)
+	{
+	}
+
+	bool IsEnabled() const { return m_bEnabled; }
+	void EnableDetour();
+	void DisableDetour();
+	void Destroy();
+
+private:
+	void *m_pCallback;
+	void **m_pTarget;	// function pointer the mock engine calls through
+	void *m_pOriginal;
+	bool m_bEnabled{false};
+};
+
+class CDetourManager
+{
+public:
+	static void Init(ISourcePawnEngine *spengine, IGameConfig *gameconf);
+
+	// Member trampolines are called with the object as first argument,
+	// so the mock engine's originals take it as a plain pointer.
+	static CDetour *CreateDetour(void *callbackfunction, void **trampoline, const char *signame);
+};
+
+#endif // _BENCH_DETOURS_H
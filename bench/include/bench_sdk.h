@@ -0,0 +1,784 @@
+#ifndef _BENCH_SDK_H
+#define _BENCH_SDK_H
+
+// Stand-ins for the parts of the HL2SDK, Metamod:Source and SourceMod headers the extension
+// sources use, so that they build and run against the mock engine of the benchmark.
+// Only what the extension touches is declared, with the same names and layouts where it matters.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef unsigned char byte;
+typedef float vec_t;
+
+#define Assert(x) assert(x)
+#define COMPILE_TIME_ASSERT(x) static_assert(x, #x)
+#define Q_memcpy memcpy
+#define Q_memset memset
+
+#define MAX_EDICT_BITS 11
+#define MAX_EDICTS (1 << MAX_EDICT_BITS)
+#define SM_MAXPLAYERS 65
+#define DT_MAX_STRING_BUFFERSIZE 512
+
+#define FL_EDICT_CHANGED (1 << 0)
+#define FL_EDICT_FREE (1 << 1)
+
+//
+// mathlib, basehandle
+//
+
+class Vector
+{
+public:
+	Vector() = default;
+	Vector(vec_t X, vec_t Y, vec_t Z) : x(X), y(Y), z(Z) {}
+
+	bool operator==(const Vector &other) const { return x == other.x && y == other.y && z == other.z; }
+	bool operator!=(const Vector &other) const { return !(*this == other); }
+
+	vec_t x, y, z;
+};
+
+#define NUM_ENT_ENTRY_BITS (MAX_EDICT_BITS + 1)
+#define ENT_ENTRY_MASK ((1 << NUM_ENT_ENTRY_BITS) - 1)
+#define INVALID_EHANDLE_INDEX 0xFFFFFFFF
+#define NUM_NETWORKED_EHANDLE_SERIAL_NUMBER_BITS 10
+#define NUM_NETWORKED_EHANDLE_BITS (MAX_EDICT_BITS + NUM_NETWORKED_EHANDLE_SERIAL_NUMBER_BITS)
+
+class CBaseHandle
+{
+public:
+	CBaseHandle() : m_Index(INVALID_EHANDLE_INDEX) {}
+	void Term() { m_Index = INVALID_EHANDLE_INDEX; }
+	bool IsValid() const { return m_Index != INVALID_EHANDLE_INDEX; }
+	int GetEntryIndex() const { return m_Index & ENT_ENTRY_MASK; }
+	unsigned long ToInt() const { return m_Index; }
+	bool operator==(const CBaseHandle &other) const { return m_Index == other.m_Index; }
+	bool operator!=(const CBaseHandle &other) const { return m_Index != other.m_Index; }
+
+	unsigned long m_Index;
+};
+
+//
+// tier0, tier1
+//
+
+double Plat_FloatTime();
+
+class CThreadFastMutex
+{
+public:
+	void Lock() {}
+	void Unlock() {}
+};
+
+// Same semantics as the SDK's: the initial size is only reserved, operator[] is unchecked
+// and elements are moved around as raw memory.
+template <class T>
+class CUtlVector
+{
+public:
+	explicit CUtlVector(int growSize = 0, int initSize = 0) { EnsureCapacity(initSize); }
+	CUtlVector(const CUtlVector &other) { *this = other; }
+	~CUtlVector() { Purge(); }
+
+	CUtlVector &operator=(const CUtlVector &other)
+	{
+		if (this != &other)
+		{
+			SetCount(other.m_Size);
+			if (m_Size > 0)
+				memcpy(m_pMemory, other.m_pMemory, m_Size * sizeof(T));
+		}
+		return *this;
+	}
+
+	T &operator[](int i) { return m_pMemory[i]; }
+	const T &operator[](int i) const { return m_pMemory[i]; }
+	T *Base() { return m_pMemory; }
+	const T *Base() const { return m_pMemory; }
+	int Count() const { return m_Size; }
+
+	int AddToTail(const T &src)
+	{
+		EnsureCapacity(m_Size + 1);
+		m_pMemory[m_Size] = src;
+		return m_Size++;
+	}
+
+	void SetCount(int count)
+	{
+		EnsureCapacity(count);
+		m_Size = count;
+	}
+
+	void EnsureCapacity(int count)
+	{
+		if (count <= m_nAllocationCount)
+			return;
+
+		m_pMemory = static_cast<T *>(realloc(static_cast<void *>(m_pMemory), count * sizeof(T)));
+		memset(static_cast<void *>(m_pMemory + m_nAllocationCount), 0, (count - m_nAllocationCount) * sizeof(T));
+		m_nAllocationCount = count;
+	}
+
+	void RemoveAll() { m_Size = 0; }
+
+	void Purge()
+	{
+		free(m_pMemory);
+		m_pMemory = nullptr;
+		m_nAllocationCount = 0;
+		m_Size = 0;
+	}
+
+private:
+	T *m_pMemory{nullptr};
+	int m_nAllocationCount{0};
+	int m_Size{0};
+};
+
+// Indices stay valid until removed, index 0 is never handed out so that it reads as invalid
+template <class T>
+class CUtlFixedLinkedList
+{
+public:
+	CUtlFixedLinkedList() { m_Elements.AddToTail(T()); }
+
+	T &operator[](int i) { return m_Elements[i]; }
+	const T &operator[](int i) const { return m_Elements[i]; }
+	int Count() const { return m_Elements.Count() - 1 - m_Free.Count(); }
+
+	int AddToTail(const T &src)
+	{
+		if (m_Free.Count() == 0)
+			return m_Elements.AddToTail(src);
+
+		const int index = m_Free[m_Free.Count() - 1];
+		m_Free.SetCount(m_Free.Count() - 1);
+		m_Elements[index] = src;
+		return index;
+	}
+
+	void Remove(int i)
+	{
+		m_Elements[i] = T();
+		m_Free.AddToTail(i);
+	}
+
+private:
+	CUtlVector<T> m_Elements;
+	CUtlVector<int> m_Free;
+};
+
+//
+// tier1/convar.h
+//
+
+#define FCVAR_NONE 0
+
+class ConCommandBase
+{
+public:
+	explicit ConCommandBase(const char *pName) : m_pszName(pName) {}
+	virtual ~ConCommandBase() = default;
+
+	const char *GetName() const { return m_pszName; }
+
+private:
+	const char *m_pszName;
+};
+
+class IConVar
+{
+public:
+	virtual void SetValue(const char *pValue) = 0;
+	virtual void SetValue(int nValue) = 0;
+};
+
+class ConVar : public ConCommandBase, public IConVar
+{
+public:
+	ConVar(const char *pName, const char *pDefaultValue, int flags = 0, const char *pHelpString = nullptr)
+		: ConCommandBase(pName), m_pParent(this), m_pszDefaultValue(pDefaultValue)
+	{
+		SetValue(pDefaultValue);
+	}
+
+	ConVar(const char *pName, const char *pDefaultValue, int flags, const char *pHelpString,
+		bool bMin, float fMin, bool bMax, float fMax)
+		: ConVar(pName, pDefaultValue, flags, pHelpString)
+	{
+	}
+
+	~ConVar() override { free(m_pszString); }
+
+	// Keeps the string value like the engine does, without the change callbacks
+	void SetValue(const char *pValue) override
+	{
+		const int len = static_cast<int>(strlen(pValue)) + 1;
+		if (len > m_StringLength)
+		{
+			m_pszString = static_cast<char *>(realloc(m_pszString, len));
+			m_StringLength = len;
+		}
+		memcpy(m_pszString, pValue, len);
+
+		m_fValue = static_cast<float>(atof(pValue));
+		m_nValue = static_cast<int>(m_fValue);
+	}
+
+	void SetValue(int nValue) override
+	{
+		char value[32];
+		snprintf(value, sizeof(value), "%d", nValue);
+		SetValue(value);
+	}
+
+	const char *GetString() const { return m_pParent->m_pszString ? m_pParent->m_pszString : ""; }
+	int GetInt() const { return m_pParent->m_nValue; }
+	float GetFloat() const { return m_pParent->m_fValue; }
+	bool GetBool() const { return GetInt() != 0; }
+
+private:
+	// Laid out as in the SDK, ConVarScopedInt writes m_nValue through a mirror of them
+	ConVar *m_pParent;
+	const char *m_pszDefaultValue;
+	char *m_pszString{nullptr};
+	int m_StringLength{0};
+	float m_fValue{0.0f};
+	int m_nValue{0};
+};
+
+class CCommand
+{
+public:
+	CCommand(int argc, const char **argv) : m_nArgc(argc), m_ppArgv(argv) {}
+
+	int ArgC() const { return m_nArgc; }
+	const char *Arg(int i) const { return i < m_nArgc ? m_ppArgv[i] : ""; }
+
+private:
+	int m_nArgc;
+	const char **m_ppArgv;
+};
+
+typedef void (*FnCommandCallback_t)(const CCommand &command);
+
+// Commands register themselves so that the benchmark can run them by name
+class ConCommand : public ConCommandBase
+{
+public:
+	ConCommand(const char *pName, FnCommandCallback_t callback, const char *pHelpString = nullptr, int flags = 0);
+
+	void Dispatch(const CCommand &command) { m_fnCommandCallback(command); }
+
+	static ConCommand *Find(const char *pName);
+
+private:
+	FnCommandCallback_t m_fnCommandCallback;
+	ConCommand *m_pNext;
+};
+
+#define CON_COMMAND(name, description) \
+	static void name##_callback(const CCommand &args); \
+	static ConCommand name##_command(#name, name##_callback, description); \
+	static void name##_callback(const CCommand &args)
+
+class IConCommandBaseAccessor
+{
+public:
+	virtual bool RegisterConCommandBase(ConCommandBase *pVar) = 0;
+};
+
+class ICvar
+{
+public:
+	virtual ConVar *FindVar(const char *pName) = 0;
+};
+
+extern ICvar *g_pCVar;
+
+#define META_REGCVAR(var) true
+#define META_CONPRINTF printf
+
+//
+// dt_send.h, server_class.h
+//
+
+typedef enum
+{
+	DPT_Int = 0,
+	DPT_Float,
+	DPT_Vector,
+	DPT_VectorXY,
+	DPT_String,
+	DPT_Array,
+	DPT_DataTable,
+	DPT_Int64,
+
+	DPT_NUMSendPropTypes
+} SendPropType;
+
+#define SPROP_UNSIGNED (1 << 0)
+#define SPROP_INSIDEARRAY (1 << 6)
+
+class DVariant
+{
+public:
+	union
+	{
+		float m_Float;
+		int m_Int;
+		const char *m_pString;
+		void *m_pData;
+		float m_Vector[3];
+		int64 m_Int64;
+	};
+	SendPropType m_Type;
+};
+
+class SendProp;
+class SendTable;
+
+class CSendProxyRecipients
+{
+public:
+	uint32 m_Bits[2];
+};
+
+typedef void (*SendVarProxyFn)(const SendProp *pProp, const void *pStructBase, const void *pData, DVariant *pOut, int iElement, int objectID);
+typedef void* (*SendTableProxyFn)(const SendProp *pProp, const void *pStructBase, const void *pData, CSendProxyRecipients *pRecipients, int objectID);
+
+class SendProp
+{
+public:
+	SendPropType GetType() const { return m_Type; }
+	const char *GetName() const { return m_pVarName; }
+	int GetFlags() const { return m_Flags; }
+	bool IsInsideArray() const { return (m_Flags & SPROP_INSIDEARRAY) != 0; }
+	int GetOffset() const { return m_Offset; }
+
+	SendVarProxyFn GetProxyFn() const { return m_ProxyFn; }
+	void SetProxyFn(SendVarProxyFn fn) { m_ProxyFn = fn; }
+
+	SendProp *GetArrayProp() const { return m_pArrayProp; }
+	int GetNumElements() const { return m_nElements; }
+	int GetElementStride() const { return m_ElementStride; }
+	SendTable *GetDataTable() const { return m_pDataTable; }
+	SendTableProxyFn GetDataTableProxyFn() const { return m_DataTableProxyFn; }
+
+	SendPropType m_Type{DPT_Int};
+	int m_nBits{32};
+	SendProp *m_pArrayProp{nullptr};
+	int m_nElements{1};
+	int m_ElementStride{0};
+	const char *m_pVarName{nullptr};
+	int m_Flags{0};
+	SendVarProxyFn m_ProxyFn{nullptr};
+	SendTableProxyFn m_DataTableProxyFn{nullptr};
+	SendTable *m_pDataTable{nullptr};
+	int m_Offset{0};
+};
+
+class SendTable
+{
+public:
+	int GetNumProps() const { return m_nProps; }
+	SendProp *GetProp(int i) { return &m_pProps[i]; }
+	const char *GetName() const { return m_pNetTableName; }
+
+	SendProp *m_pProps{nullptr};
+	int m_nProps{0};
+	const char *m_pNetTableName{nullptr};
+};
+
+class ServerClass
+{
+public:
+	const char *GetName() { return m_pNetworkName; }
+
+	const char *m_pNetworkName{nullptr};
+	SendTable *m_pTable{nullptr};
+	ServerClass *m_pNext{nullptr};
+	int m_ClassID{0};
+	int m_InstanceBaselineIndex{-1};
+};
+
+//
+// edict.h, eiface.h, iclient.h
+//
+
+class CBaseEntity;
+
+class IServerNetworkable
+{
+public:
+	virtual ServerClass *GetServerClass() = 0;
+};
+
+class IServerUnknown
+{
+public:
+	virtual IServerNetworkable *GetNetworkable() = 0;
+};
+
+struct edict_t
+{
+	bool IsFree() const { return (m_fStateFlags & FL_EDICT_FREE) != 0; }
+	bool HasStateChanged() const { return (m_fStateFlags & FL_EDICT_CHANGED) != 0; }
+	void StateChanged() { m_fStateFlags |= FL_EDICT_CHANGED; }
+	IServerUnknown *GetUnknown() { return m_pUnk; }
+
+	int m_fStateFlags{0};
+	int m_NetworkSerialNumber{0};
+	IServerUnknown *m_pUnk{nullptr};
+};
+
+template <int BITS>
+class CBitVec
+{
+public:
+	bool Get(int bit) const { return (m_Ints[bit >> 5] >> (bit & 31)) & 1; }
+	bool IsBitSet(int bit) const { return Get(bit); }
+	void Set(int bit) { m_Ints[bit >> 5] |= 1u << (bit & 31); }
+	void Clear(int bit) { m_Ints[bit >> 5] &= ~(1u << (bit & 31)); }
+	void ClearAll() { memset(m_Ints, 0, sizeof(m_Ints)); }
+
+private:
+	uint32 m_Ints[(BITS + 31) / 32]{};
+};
+
+class CCheckTransmitInfo
+{
+public:
+	edict_t *m_pClientEnt{nullptr};
+	CBitVec<MAX_EDICTS> *m_pTransmitEdict{nullptr};
+	CBitVec<MAX_EDICTS> *m_pTransmitAlways{nullptr};
+};
+
+#define INTERFACEVERSION_SERVERGAMEENTS "ServerGameEnts001"
+
+class IServerGameEnts
+{
+public:
+	virtual void CheckTransmit(CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts) = 0;
+};
+
+class IServerGameClients;
+
+class CGlobalVars
+{
+public:
+	int maxClients{0};
+	int maxEntities{MAX_EDICTS};
+	int tickcount{0};
+};
+
+class IClient
+{
+public:
+	virtual int GetPlayerSlot() const = 0;
+};
+
+//
+// SourceHook, only static post hooks
+//
+
+enum META_RES
+{
+	MRES_IGNORED = 0,
+	MRES_HANDLED,
+	MRES_OVERRIDE,
+	MRES_SUPERCEDE,
+};
+
+namespace BenchSourceHook
+{
+	// Hooks are looked up by "Interface::Function", the mock engine calls them after the function
+	int AddHook(const char *name, void *iface, void *handler, bool post);
+	bool RemoveHook(const char *name, void *iface, void *handler, bool post);
+	void *FindHook(const char *name, void *iface);
+}
+
+#define SH_DECL_HOOK3_void(ifacetype, ifacefunc, attr, overload, param1, param2, param3)
+#define SH_STATIC(func) reinterpret_cast<void *>(&func)
+#define SH_ADD_HOOK(ifacetype, ifacefunc, ifaceptr, handler, post) \
+	BenchSourceHook::AddHook(#ifacetype "::" #ifacefunc, ifaceptr, handler, post)
+#define SH_REMOVE_HOOK(ifacetype, ifacefunc, ifaceptr, handler, post) \
+	BenchSourceHook::RemoveHook(#ifacetype "::" #ifacefunc, ifaceptr, handler, post)
+#define RETURN_META(result) return
+
+//
+// Metamod:Source
+//
+
+typedef void *(*CreateInterfaceFn)(const char *pName, int *pReturnCode);
+
+class ISmmAPI
+{
+public:
+	virtual CGlobalVars *GetCGlobals() = 0;
+	virtual CreateInterfaceFn GetServerFactory(bool syn = true) = 0;
+	virtual void Format(char *buffer, size_t maxlength, const char *format, ...) = 0;
+
+	void *VInterfaceMatch(CreateInterfaceFn fn, const char *iface, int min = -1) { return fn(iface, nullptr); }
+};
+
+#define GET_V_IFACE_ANY(v_factory, v_var, v_type, v_name) \
+	v_var = static_cast<v_type *>(ismm->VInterfaceMatch(ismm->v_factory(), v_name))
+
+//
+// SourceMod
+//
+
+#define SMINTERFACE_SDKHOOKS_NAME "ISDKHooks"
+#define SMINTERFACE_SDKTOOLS_NAME "ISDKTools"
+#define SMINTERFACE_BINTOOLS_NAME "IBinTools"
+
+#define SM_PARAM_COPYBACK (1 << 0)
+#define SM_PARAM_STRING_UTF8 (1 << 0)
+#define SM_PARAM_STRING_COPY (1 << 1)
+
+#define SM_GET_LATE_IFACE(prefix, addr) \
+	sharesys->RequestInterface(SMINTERFACE_##prefix##_NAME, 0, myself, reinterpret_cast<SMInterface **>(&addr))
+#define SM_CHECK_IFACE(prefix, addr) \
+	if (!addr) return false
+
+class ISourcePawnEngine;
+
+namespace SourceMod
+{
+	typedef int32_t cell_t;
+
+	enum ResultType
+	{
+		Pl_Continue = 0,
+		Pl_Changed = 1,
+		Pl_Handled = 3,
+		Pl_Stop = 4,
+	};
+
+	class SMInterface
+	{
+	public:
+		virtual const char *GetInterfaceName() = 0;
+		virtual unsigned int GetInterfaceVersion() = 0;
+	};
+
+	class IExtension
+	{
+	public:
+		virtual const char *GetFilename() = 0;
+	};
+
+	class IPluginFunction;
+
+	class IPluginContext
+	{
+	public:
+		virtual void BlamePluginError(IPluginFunction *pFunc, const char *fmt, ...) = 0;
+	};
+
+	class IPluginRuntime
+	{
+	public:
+		virtual IPluginContext *GetDefaultContext() = 0;
+	};
+
+	class IPlugin
+	{
+	public:
+		virtual IPluginRuntime *GetRuntime() = 0;
+	};
+
+	class IPluginFunction
+	{
+	public:
+		virtual int PushCell(cell_t cell) = 0;
+		virtual int PushCellByRef(cell_t *cell, int flags = SM_PARAM_COPYBACK) = 0;
+		virtual int PushFloatByRef(float *number, int flags = SM_PARAM_COPYBACK) = 0;
+		virtual int PushArray(cell_t *inarray, unsigned int cells, int flags = 0) = 0;
+		virtual int PushString(const char *string) = 0;
+		virtual int PushStringEx(char *buffer, size_t length, int sz_flags, int cp_flags) = 0;
+		virtual int Execute(cell_t *result) = 0;
+		virtual IPluginRuntime *GetParentRuntime() = 0;
+	};
+
+	class IPluginsListener
+	{
+	public:
+		virtual void OnPluginUnloaded(IPlugin *plugin) {}
+	};
+
+	class IClientListener
+	{
+	public:
+		virtual void OnClientDisconnected(int client) {}
+	};
+
+	class ISMEntityListener
+	{
+	public:
+		virtual void OnEntityDestroyed(CBaseEntity *pEntity) {}
+	};
+
+	class IGameConfig
+	{
+	public:
+		virtual bool GetMemSig(const char *key, void **addr) = 0;
+		virtual bool GetAddress(const char *key, void **addr) = 0;
+		virtual const char *GetKeyValue(const char *key) = 0;
+	};
+
+	class IGameConfigManager
+	{
+	public:
+		virtual bool LoadGameConfigFile(const char *file, IGameConfig **pConfig, char *error, size_t maxlength) = 0;
+		virtual void CloseGameConfigFile(IGameConfig *cfg) = 0;
+	};
+
+	class IGameHelpers
+	{
+	public:
+		virtual edict_t *EdictOfIndex(int index) = 0;
+		virtual int IndexOfEdict(edict_t *pEdict) = 0;
+		virtual CBaseEntity *ReferenceToEntity(int entRef) = 0;
+		virtual int EntityToReference(CBaseEntity *pEntity) = 0;
+		virtual int EntityToBCompatRef(CBaseEntity *pEntity) = 0;
+		virtual ServerClass *FindServerClass(const char *classname) = 0;
+		virtual const char *GetEntityClassname(edict_t *pEdict) = 0;
+		virtual edict_t *GetHandleEntity(CBaseHandle &hndl) = 0;
+		virtual void SetHandleEntity(CBaseHandle &hndl, edict_t *pEnt) = 0;
+	};
+
+	class IPlayerManager
+	{
+	public:
+		virtual int GetMaxClients() = 0;
+		virtual void AddClientListener(IClientListener *listener) = 0;
+		virtual void RemoveClientListener(IClientListener *listener) = 0;
+	};
+
+	class ISourceMod
+	{
+	public:
+		virtual void LogMessage(IExtension *pExt, const char *format, ...) = 0;
+		virtual void LogError(IExtension *pExt, const char *format, ...) = 0;
+	};
+
+	class IShareSys
+	{
+	public:
+		virtual bool RequestInterface(const char *iface_name, unsigned int iface_vers, IExtension *myself, SMInterface **pIface) = 0;
+		virtual void AddDependency(IExtension *myself, const char *filename, bool require, bool autoload) = 0;
+	};
+
+	class IPluginManager
+	{
+	public:
+		virtual void AddPluginsListener(IPluginsListener *listener) = 0;
+		virtual void RemovePluginsListener(IPluginsListener *listener) = 0;
+	};
+
+	class ISourceModUtils
+	{
+	public:
+		virtual ISourcePawnEngine *GetScriptingEngine() = 0;
+		virtual size_t Format(char *buffer, size_t maxlength, const char *fmt, ...) = 0;
+	};
+
+	enum PassType
+	{
+		PassType_Basic,
+	};
+
+	enum CallConvention
+	{
+		CallConv_ThisCall,
+		CallConv_Cdecl,
+	};
+
+	#define PASSFLAG_BYVAL (1 << 0)
+
+	struct PassInfo
+	{
+		PassType type;
+		unsigned int flags;
+		size_t size;
+		void *info;
+		unsigned int fields;
+	};
+
+	class ICallWrapper
+	{
+	public:
+		virtual void Execute(void *vParamStack, void *retBuffer) = 0;
+		virtual void Destroy() = 0;
+	};
+
+	class IBinTools : public SMInterface
+	{
+	public:
+		virtual ICallWrapper *CreateCall(void *address, CallConvention cv, const PassInfo *retInfo, const PassInfo paramInfo[], unsigned int numParams) = 0;
+	};
+
+	class ISDKHooks : public SMInterface
+	{
+	public:
+		virtual void AddEntityListener(ISMEntityListener *listener) = 0;
+		virtual void RemoveEntityListener(ISMEntityListener *listener) = 0;
+	};
+
+	class ISDKTools : public SMInterface
+	{
+	public:
+		virtual void *GetGameRules() = 0;
+	};
+
+	class SDKExtension
+	{
+	public:
+		virtual bool SDK_OnLoad(char *error, size_t maxlength, bool late) { return true; }
+		virtual void SDK_OnUnload() {}
+		virtual void SDK_OnAllLoaded() {}
+		virtual bool QueryInterfaceDrop(SMInterface *pInterface) { return true; }
+		virtual void NotifyInterfaceDrop(SMInterface *pInterface) {}
+		virtual bool QueryRunning(char *error, size_t maxlength) { return true; }
+		virtual bool SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlength, bool late) { return true; }
+		virtual void OnCoreMapEnd() {}
+	};
+}
+
+using namespace SourceMod;
+
+extern ISourceMod *g_pSM;
+extern IExtension *myself;
+extern IShareSys *sharesys;
+extern IPluginManager *plsys;
+extern IGameConfigManager *gameconfs;
+extern IGameHelpers *gamehelpers;
+extern IPlayerManager *playerhelpers;
+extern ISourceModUtils *smutils;
+
+namespace ke
+{
+	inline size_t SafeStrcpy(char *dest, size_t maxlength, const char *src)
+	{
+		return static_cast<size_t>(snprintf(dest, maxlength, "%s", src));
+	}
+}
+
+#endif // _BENCH_SDK_H
@@ -0,0 +1,4 @@
+#pragma once
+
+#include "bench_sdk.h"
+#include "smsdk_config.h"
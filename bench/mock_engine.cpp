@@ -0,0 +1,932 @@
+#include "mock_engine.h"
+#include "CDetour/detours.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+
+MockServer g_MockServer;
+
+//
+// Engine functions the extension detours, called through this table like through patched code
+//
+
+enum class EngineFunc
+{
+	SV_ComputeClientPacks,
+	PackEntities_Normal,
+	UsePreviouslySentPacket,
+	GetPreviouslySentPacket,
+	CreatePackedEntity,
+	ReleaseReference,
+
+	Count
+};
+
+struct EngineFunction
+{
+	const char *name;	// gamedata name
+	void *original;
+	void *current;		// original, or the callback of the detour while enabled
+};
+
+// Member trampolines are member function pointers, whose low bit flags a virtual call in the Itanium ABI
+#if defined(__GNUC__)
+#define ENGINE_FUNCTION __attribute__((aligned(16)))
+#else
+#define ENGINE_FUNCTION
+#endif
+
+ENGINE_FUNCTION static void Engine_SV_ComputeClientPacks(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot);
+ENGINE_FUNCTION static void Engine_PackEntities_Normal(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot);
+ENGINE_FUNCTION static bool Engine_UsePreviouslySentPacket(CFrameSnapshotManager *pThis, CFrameSnapshot *pSnapshot, int entity, int entSerialNumber);
+ENGINE_FUNCTION static PackedEntity *Engine_GetPreviouslySentPacket(CFrameSnapshotManager *pThis, int entity, int entSerialNumber);
+ENGINE_FUNCTION static PackedEntity *Engine_CreatePackedEntity(CFrameSnapshotManager *pThis, CFrameSnapshot *pSnapshot, int entity);
+ENGINE_FUNCTION static void Engine_ReleaseReference(CFrameSnapshot *pThis);
+
+static EngineFunction s_EngineFunctions[] = {
+	{ "SV_ComputeClientPacks", reinterpret_cast<void *>(&Engine_SV_ComputeClientPacks), nullptr },
+	{ "PackEntities_Normal", reinterpret_cast<void *>(&Engine_PackEntities_Normal), nullptr },
+	{ "CFrameSnapshotManager::UsePreviouslySentPacket", reinterpret_cast<void *>(&Engine_UsePreviouslySentPacket), nullptr },
+	{ "CFrameSnapshotManager::GetPreviouslySentPacket", reinterpret_cast<void *>(&Engine_GetPreviouslySentPacket), nullptr },
+	{ "CFrameSnapshotManager::CreatePackedEntity", reinterpret_cast<void *>(&Engine_CreatePackedEntity), nullptr },
+	{ "CFrameSnapshot::ReleaseReference", reinterpret_cast<void *>(&Engine_ReleaseReference), nullptr },
+};
+
+static_assert(std::size(s_EngineFunctions) == static_cast<size_t>(EngineFunc::Count));
+
+// The engine's own pointer to the game's IServerGameEnts, which the extension hooks
+static IServerGameEnts *serverGameEnts = nullptr;
+
+template <typename Fn>
+static Fn GetEngineFunction(EngineFunc func)
+{
+	return reinterpret_cast<Fn>(s_EngineFunctions[static_cast<int>(func)].current);
+}
+
+static void SV_ComputeClientPacks(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot)
+{
+	GetEngineFunction<decltype(&Engine_SV_ComputeClientPacks)>(EngineFunc::SV_ComputeClientPacks)(clientCount, clients, snapshot);
+}
+
+static void PackEntities_Normal(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot)
+{
+	GetEngineFunction<decltype(&Engine_PackEntities_Normal)>(EngineFunc::PackEntities_Normal)(clientCount, clients, snapshot);
+}
+
+static bool UsePreviouslySentPacket(CFrameSnapshot *pSnapshot, int entity, int entSerialNumber)
+{
+	return GetEngineFunction<decltype(&Engine_UsePreviouslySentPacket)>(EngineFunc::UsePreviouslySentPacket)(framesnapshotmanager, pSnapshot, entity, entSerialNumber);
+}
+
+static PackedEntity *GetPreviouslySentPacket(int entity, int entSerialNumber)
+{
+	return GetEngineFunction<decltype(&Engine_GetPreviouslySentPacket)>(EngineFunc::GetPreviouslySentPacket)(framesnapshotmanager, entity, entSerialNumber);
+}
+
+static PackedEntity *CreatePackedEntity(CFrameSnapshot *pSnapshot, int entity)
+{
+	return GetEngineFunction<decltype(&Engine_CreatePackedEntity)>(EngineFunc::CreatePackedEntity)(framesnapshotmanager, pSnapshot, entity);
+}
+
+static void ReleaseReference(CFrameSnapshot *pSnapshot)
+{
+	GetEngineFunction<decltype(&Engine_ReleaseReference)>(EngineFunc::ReleaseReference)(pSnapshot);
+}
+
+void CDetourManager::Init(ISourcePawnEngine *spengine, IGameConfig *gameconf)
+{
+}
+
+CDetour *CDetourManager::CreateDetour(void *callbackfunction, void **trampoline, const char *signame)
+{
+	for (EngineFunction &func : s_EngineFunctions)
+	{
+		if (!strcmp(func.name, signame))
+		{
+			*trampoline = func.original;
+			return new CDetour(callbackfunction, &func.current, func.original);
+		}
+	}
+
+	g_pSM->LogError(myself, "Signature for %s not found", signame);
+	return nullptr;
+}
+
+void CDetour::EnableDetour()
+{
+	*m_pTarget = m_pCallback;
+	m_bEnabled = true;
+}
+
+void CDetour::DisableDetour()
+{
+	*m_pTarget = m_pOriginal;
+	m_bEnabled = false;
+}
+
+void CDetour::Destroy()
+{
+	DisableDetour();
+	delete this;
+}
+
+//
+// CFrameSnapshotManager, as in framesnapshot.cpp
+//
+
+struct UnpackedDataCache_t
+{
+	PackedEntity *pEntity;
+	int counter;
+	int bits;
+	char data[4096];
+};
+
+CFrameSnapshotManager::~CFrameSnapshotManager()
+{
+}
+
+static CFrameSnapshot *Engine_CreateEmptySnapshot(CFrameSnapshotManager *pThis, int tickcount, int maxEntities)
+{
+	CFrameSnapshot *snap = new CFrameSnapshot;
+	snap->m_nReferences = 1;
+	snap->m_nTickCount = tickcount;
+	snap->m_nNumEntities = maxEntities;
+	snap->m_nValidEntities = 0;
+	snap->m_pValidEntities = nullptr;
+	snap->m_pHLTVEntityData = nullptr;
+	snap->m_pTempEntities = nullptr;
+	snap->m_nTempEntities = 0;
+	snap->m_pEntities = new CFrameSnapshotEntry[maxEntities];
+
+	for (int i = 0; i < maxEntities; ++i)
+	{
+		snap->m_pEntities[i].m_pClass = nullptr;
+		snap->m_pEntities[i].m_nSerialNumber = -1;
+		snap->m_pEntities[i].m_pPackedData = INVALID_PACKED_ENTITY_HANDLE;
+	}
+
+	return snap;
+}
+
+static void Engine_RemoveEntityReference(CFrameSnapshotManager *pThis, PackedEntityHandle_t handle)
+{
+	PackedEntity *packedEntity = pThis->m_PackedEntities[handle];
+	if (--packedEntity->m_ReferenceCount == 0)
+	{
+		free(packedEntity->m_pData);
+		delete packedEntity;
+		pThis->m_PackedEntities.Remove(handle);
+	}
+}
+
+static void Engine_DeleteFrameSnapshot(CFrameSnapshot *pSnapshot)
+{
+	for (int i = 0; i < pSnapshot->m_nNumEntities; ++i)
+	{
+		if (pSnapshot->m_pEntities[i].m_pPackedData != INVALID_PACKED_ENTITY_HANDLE)
+			Engine_RemoveEntityReference(framesnapshotmanager, pSnapshot->m_pEntities[i].m_pPackedData);
+	}
+
+	delete[] pSnapshot->m_pEntities;
+	delete[] pSnapshot->m_pValidEntities;
+	delete[] pSnapshot->m_pHLTVEntityData;
+	delete pSnapshot;
+}
+
+static void Engine_ReleaseReference(CFrameSnapshot *pThis)
+{
+	if (--pThis->m_nReferences == 0)
+		Engine_DeleteFrameSnapshot(pThis);
+}
+
+static bool Engine_UsePreviouslySentPacket(CFrameSnapshotManager *pThis, CFrameSnapshot *pSnapshot, int entity, int entSerialNumber)
+{
+	PackedEntityHandle_t handle = pThis->m_pLastPackedData[entity];
+	if (handle == INVALID_PACKED_ENTITY_HANDLE || pThis->m_pSerialNumber[entity] != entSerialNumber)
+		return false;
+
+	pThis->AddEntityReference(handle);
+	pSnapshot->m_pEntities[entity].m_pPackedData = handle;
+	return true;
+}
+
+static PackedEntity *Engine_GetPreviouslySentPacket(CFrameSnapshotManager *pThis, int entity, int entSerialNumber)
+{
+	PackedEntityHandle_t handle = pThis->m_pLastPackedData[entity];
+	if (handle == INVALID_PACKED_ENTITY_HANDLE || pThis->m_pSerialNumber[entity] != entSerialNumber)
+		return nullptr;
+
+	return pThis->m_PackedEntities[handle];
+}
+
+static PackedEntity *Engine_CreatePackedEntity(CFrameSnapshotManager *pThis, CFrameSnapshot *pSnapshot, int entity)
+{
+	PackedEntity *packedEntity = new PackedEntity();
+	PackedEntityHandle_t handle = pThis->m_PackedEntities.AddToTail(packedEntity);
+
+	// Referenced by the snapshot and as the last packed data of the entity
+	packedEntity->m_ReferenceCount = 2;
+	packedEntity->m_nEntityIndex = entity;
+	pSnapshot->m_pEntities[entity].m_pPackedData = handle;
+
+	if (pThis->m_pLastPackedData[entity] != INVALID_PACKED_ENTITY_HANDLE)
+		Engine_RemoveEntityReference(pThis, pThis->m_pLastPackedData[entity]);
+
+	pThis->m_pLastPackedData[entity] = handle;
+	pThis->m_pSerialNumber[entity] = pSnapshot->m_pEntities[entity].m_nSerialNumber;
+	packedEntity->m_nSnapshotCreationTick = pSnapshot->m_nTickCount;
+
+	return packedEntity;
+}
+
+// Calls made by the extension through bintools
+class CreateEmptySnapshotCall final : public ICallWrapper
+{
+public:
+	void Execute(void *vParamStack, void *retBuffer) override
+	{
+		struct {
+			CFrameSnapshotManager *pThis;
+			int tickcount;
+			int maxEntities;
+		} *stack = static_cast<decltype(stack)>(vParamStack);
+
+		*static_cast<CFrameSnapshot **>(retBuffer) = Engine_CreateEmptySnapshot(stack->pThis, stack->tickcount, stack->maxEntities);
+	}
+
+	void Destroy() override { delete this; }
+};
+
+class RemoveEntityReferenceCall final : public ICallWrapper
+{
+public:
+	void Execute(void *vParamStack, void *retBuffer) override
+	{
+		struct {
+			CFrameSnapshotManager *pThis;
+			PackedEntityHandle_t handle;
+		} *stack = static_cast<decltype(stack)>(vParamStack);
+
+		Engine_RemoveEntityReference(stack->pThis, stack->handle);
+	}
+
+	void Destroy() override { delete this; }
+};
+
+// Goes through the detour, as the call wrapper jumps to the patched function
+class ReleaseReferenceCall final : public ICallWrapper
+{
+public:
+	void Execute(void *vParamStack, void *retBuffer) override
+	{
+		struct {
+			CFrameSnapshot *pThis;
+		} *stack = static_cast<decltype(stack)>(vParamStack);
+
+		ReleaseReference(stack->pThis);
+	}
+
+	void Destroy() override { delete this; }
+};
+
+//
+// Entity packing, as in sv_ents.cpp
+//
+
+void SendProxy_Int32ToInt32(const SendProp *pProp, const void *pStruct, const void *pData, DVariant *pOut, int iElement, int objectID)
+{
+	pOut->m_Int = *static_cast<const int *>(pData);
+	pOut->m_Type = DPT_Int;
+}
+
+void *SendProxy_DataTableToDataTable(const SendProp *pProp, const void *pStructBase, const void *pData, CSendProxyRecipients *pRecipients, int objectID)
+{
+	return const_cast<void *>(pData);
+}
+
+// Walk of SendTable_Encode: a table is sent from what its proxy returns, the elements of an array
+// from the offset of its array prop, as Array_Encode does. send gets each prop with the data of its proxy.
+template <typename SendFn>
+static void Engine_EncodeTable(SendTable *pTable, const void *pStruct, int objectID, SendFn &&send)
+{
+	for (int i = 0; i < pTable->GetNumProps(); ++i)
+	{
+		const SendProp *pProp = pTable->GetProp(i);
+		const uint8_t *pData = static_cast<const uint8_t *>(pStruct) + pProp->GetOffset();
+
+		// Sent by the array prop that follows it
+		if (pProp->IsInsideArray())
+			continue;
+
+		if (pProp->GetType() == DPT_DataTable)
+		{
+			CSendProxyRecipients recipients;
+			if (const void *pTableStruct = pProp->GetDataTableProxyFn()(pProp, pStruct, pData, &recipients, objectID))
+				Engine_EncodeTable(pProp->GetDataTable(), pTableStruct, objectID, send);
+		}
+		else if (pProp->GetType() == DPT_Array)
+		{
+			const SendProp *pArrayProp = pProp->GetArrayProp();
+			const uint8_t *pElement = static_cast<const uint8_t *>(pStruct) + pArrayProp->GetOffset();
+
+			for (int element = 0; element < pProp->GetNumElements(); ++element, pElement += pProp->GetElementStride())
+				send(pArrayProp, pStruct, pElement, element);
+		}
+		else
+		{
+			send(pProp, pStruct, pData, 0);
+		}
+	}
+}
+
+// Stand-in of SendTable_Encode, the props are written as they come out of their proxy
+static int Engine_EncodeEntity(SendTable *pTable, const void *pStruct, int objectID, int *pPackedData)
+{
+	int count = 0;
+	Engine_EncodeTable(pTable, pStruct, objectID, [&](const SendProp *pProp, const void *pStructBase, const void *pData, int element)
+		{
+			DVariant out;
+			pProp->GetProxyFn()(pProp, pStructBase, pData, &out, element, objectID);
+			pPackedData[count++] = out.m_Int;
+		});
+
+	return count * static_cast<int>(sizeof(int));
+}
+
+static void Engine_PackEntity(int edictIdx, edict_t *edict, ServerClass *pServerClass, CFrameSnapshot *pSnapshot)
+{
+	const int iSerialNum = pSnapshot->m_pEntities[edictIdx].m_nSerialNumber;
+
+	if (!edict->HasStateChanged() && UsePreviouslySentPacket(pSnapshot, edictIdx, iSerialNum))
+	{
+		edict->m_fStateFlags &= ~FL_EDICT_CHANGED;
+		return;
+	}
+
+	int packedData[MAX_BENCH_PROPS];
+	const int size = Engine_EncodeEntity(pServerClass->m_pTable, edict->GetUnknown(), edictIdx, packedData);
+
+	// Nothing changed since the last packet, it is sent again
+	PackedEntity *pPrevFrame = GetPreviouslySentPacket(edictIdx, iSerialNum);
+	if (pPrevFrame && pPrevFrame->m_nBits == size * 8 && !memcmp(pPrevFrame->m_pData, packedData, size))
+	{
+		if (UsePreviouslySentPacket(pSnapshot, edictIdx, iSerialNum))
+		{
+			edict->m_fStateFlags &= ~FL_EDICT_CHANGED;
+			return;
+		}
+	}
+
+	PackedEntity *pPackedEntity = CreatePackedEntity(pSnapshot, edictIdx);
+	pPackedEntity->m_pServerClass = pServerClass;
+	pPackedEntity->m_pData = malloc(size);
+	memcpy(pPackedEntity->m_pData, packedData, size);
+	pPackedEntity->m_nBits = size * 8;
+
+	edict->m_fStateFlags &= ~FL_EDICT_CHANGED;
+}
+
+// Packs each valid entity transmitted by at least one of the clients
+static void Engine_PackEntities_Normal(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot)
+{
+	for (int iValidEdict = 0; iValidEdict < snapshot->m_nValidEntities; ++iValidEdict)
+	{
+		const int index = snapshot->m_pValidEntities[iValidEdict];
+		edict_t *edict = gamehelpers->EdictOfIndex(index);
+
+		for (int iClient = 0; iClient < clientCount; ++iClient)
+		{
+			const BenchClient &client = reinterpret_cast<BenchGameClient *>(clients[iClient])->m_Client;
+			if (client.m_TransmitEdict.Get(index))
+			{
+				Engine_PackEntity(index, edict, snapshot->m_pEntities[index].m_pClass, snapshot);
+				break;
+			}
+		}
+	}
+}
+
+// Sets up the frame of each client, which references the snapshot, then packs it
+static void Engine_SV_ComputeClientPacks(int clientCount, CGameClient **clients, CFrameSnapshot *snapshot)
+{
+	for (int iClient = 0; iClient < clientCount; ++iClient)
+	{
+		BenchClient &client = reinterpret_cast<BenchGameClient *>(clients[iClient])->m_Client;
+
+		if (client.m_pFrameSnapshot)
+			ReleaseReference(client.m_pFrameSnapshot);
+		client.m_pFrameSnapshot = snapshot;
+		++snapshot->m_nReferences;
+
+		CCheckTransmitInfo info;
+		info.m_pClientEnt = gamehelpers->EdictOfIndex(client.m_nPlayerSlot + 1);
+		info.m_pTransmitEdict = &client.m_TransmitEdict;
+		info.m_pTransmitEdict->ClearAll();
+		serverGameEnts->CheckTransmit(&info, snapshot->m_pValidEntities, snapshot->m_nValidEntities);
+	}
+
+	PackEntities_Normal(clientCount, clients, snapshot);
+}
+
+static CFrameSnapshot *Engine_TakeTickSnapshot(int tickcount, int numEdicts)
+{
+	CFrameSnapshot *snap = Engine_CreateEmptySnapshot(framesnapshotmanager, tickcount, numEdicts);
+	snap->m_pValidEntities = new unsigned short[numEdicts];
+
+	int nValidEntities = 0;
+	for (int i = 0; i < numEdicts; ++i)
+	{
+		edict_t *edict = gamehelpers->EdictOfIndex(i);
+		if (edict->IsFree())
+			continue;
+
+		snap->m_pEntities[i].m_nSerialNumber = edict->m_NetworkSerialNumber;
+		snap->m_pEntities[i].m_pClass = edict->GetUnknown()->GetNetworkable()->GetServerClass();
+		snap->m_pValidEntities[nValidEntities++] = i;
+	}
+	snap->m_nValidEntities = nValidEntities;
+
+	return snap;
+}
+
+//
+// Game interfaces
+//
+
+class BenchServerGameEnts : public IServerGameEnts
+{
+public:
+	void CheckTransmit(CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts) override
+	{
+		const int client = gamehelpers->IndexOfEdict(pInfo->m_pClientEnt) - 1;
+		for (int i = 0; i < nEdicts; ++i)
+		{
+			if (g_MockServer.IsVisible(client, pEdictIndices[i]))
+				pInfo->m_pTransmitEdict->Set(pEdictIndices[i]);
+		}
+
+		using CheckTransmitHook = void (*)(CCheckTransmitInfo *, const unsigned short *, int);
+		if (void *pHook = BenchSourceHook::FindHook("IServerGameEnts::CheckTransmit", this))
+			reinterpret_cast<CheckTransmitHook>(pHook)(pInfo, pEdictIndices, nEdicts);
+	}
+};
+
+class BenchGameHelpers : public IGameHelpers
+{
+public:
+	edict_t *EdictOfIndex(int index) override
+	{
+		return index >= 0 && index < static_cast<int>(m_pEdicts->size()) ? &(*m_pEdicts)[index] : nullptr;
+	}
+
+	int IndexOfEdict(edict_t *pEdict) override { return static_cast<int>(pEdict - m_pEdicts->data()); }
+
+	// References are plain indexes here
+	CBaseEntity *ReferenceToEntity(int entRef) override
+	{
+		edict_t *edict = EdictOfIndex(entRef);
+		return edict && !edict->IsFree() ? reinterpret_cast<CBaseEntity *>(edict->GetUnknown()) : nullptr;
+	}
+
+	int EntityToReference(CBaseEntity *pEntity) override { return EntityToBCompatRef(pEntity); }
+
+	int EntityToBCompatRef(CBaseEntity *pEntity) override
+	{
+		for (size_t i = 0; i < m_pEdicts->size(); ++i)
+		{
+			if (reinterpret_cast<CBaseEntity *>((*m_pEdicts)[i].GetUnknown()) == pEntity)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	ServerClass *FindServerClass(const char *classname) override
+	{
+		for (ServerClass *sc : { g_MockServer.GetServerClass(), g_MockServer.GetNestedServerClass() })
+		{
+			if (!strcmp(sc->GetName(), classname))
+				return sc;
+		}
+		return nullptr;
+	}
+
+	// Every edict has its networkable, the ServerClass is found from it
+	const char *GetEntityClassname(edict_t *pEdict) override { return nullptr; }
+
+	edict_t *GetHandleEntity(CBaseHandle &hndl) override
+	{
+		return hndl.IsValid() ? EdictOfIndex(hndl.GetEntryIndex()) : nullptr;
+	}
+
+	void SetHandleEntity(CBaseHandle &hndl, edict_t *pEnt) override
+	{
+		hndl.m_Index = IndexOfEdict(pEnt);
+	}
+
+	std::vector<edict_t> *m_pEdicts{nullptr};
+};
+
+class BenchPlayerManager : public IPlayerManager
+{
+public:
+	int GetMaxClients() override { return g_MockServer.GetNumClients(); }
+	void AddClientListener(IClientListener *listener) override {}
+	void RemoveClientListener(IClientListener *listener) override {}
+};
+
+class BenchSourceMod : public ISourceMod
+{
+public:
+	void LogMessage(IExtension *pExt, const char *format, ...) override
+	{
+		va_list ap;
+		va_start(ap, format);
+		vprintf(format, ap);
+		va_end(ap);
+		printf("\n");
+	}
+
+	void LogError(IExtension *pExt, const char *format, ...) override
+	{
+		va_list ap;
+		va_start(ap, format);
+		vfprintf(stderr, format, ap);
+		va_end(ap);
+		fprintf(stderr, "\n");
+	}
+};
+
+class BenchSourceModUtils : public ISourceModUtils
+{
+public:
+	ISourcePawnEngine *GetScriptingEngine() override { return nullptr; }
+
+	size_t Format(char *buffer, size_t maxlength, const char *fmt, ...) override
+	{
+		va_list ap;
+		va_start(ap, fmt);
+		const int len = vsnprintf(buffer, maxlength, fmt, ap);
+		va_end(ap);
+		return len < 0 ? 0 : std::min(static_cast<size_t>(len), maxlength - 1);
+	}
+};
+
+static BenchServerGameEnts s_ServerGameEnts;
+static BenchGameHelpers s_GameHelpers;
+static BenchPlayerManager s_PlayerManager;
+static BenchSourceMod s_SourceMod;
+static BenchSourceModUtils s_SourceModUtils;
+
+static ConVar s_sv_parallel_packentities("sv_parallel_packentities", "1");
+static void *s_pLocalNetworkBackdoor = nullptr;
+
+ISourceMod *g_pSM = &s_SourceMod;
+IExtension *myself = nullptr;
+IShareSys *sharesys = nullptr;
+IPluginManager *plsys = nullptr;
+IGameConfigManager *gameconfs = nullptr;
+IGameHelpers *gamehelpers = &s_GameHelpers;
+IPlayerManager *playerhelpers = &s_PlayerManager;
+ISourceModUtils *smutils = &s_SourceModUtils;
+ICvar *g_pCVar = nullptr;
+
+double Plat_FloatTime()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// ConCommands and SourceHook
+//
+
+static ConCommand *s_pConCommands = nullptr;
+
+ConCommand::ConCommand(const char *pName, FnCommandCallback_t callback, const char *pHelpString, int flags)
+	: ConCommandBase(pName), m_fnCommandCallback(callback), m_pNext(s_pConCommands)
+{
+	s_pConCommands = this;
+}
+
+ConCommand *ConCommand::Find(const char *pName)
+{
+	for (ConCommand *pCommand = s_pConCommands; pCommand; pCommand = pCommand->m_pNext)
+	{
+		if (!strcmp(pCommand->GetName(), pName))
+			return pCommand;
+	}
+	return nullptr;
+}
+
+struct BenchHook
+{
+	std::string name;
+	void *iface;
+	void *handler;
+	bool post;
+};
+static std::vector<BenchHook> s_Hooks;
+
+int BenchSourceHook::AddHook(const char *name, void *iface, void *handler, bool post)
+{
+	s_Hooks.push_back({ name, iface, handler, post });
+	return static_cast<int>(s_Hooks.size());
+}
+
+bool BenchSourceHook::RemoveHook(const char *name, void *iface, void *handler, bool post)
+{
+	for (auto it = s_Hooks.begin(); it != s_Hooks.end(); ++it)
+	{
+		if (it->name == name && it->iface == iface && it->handler == handler && it->post == post)
+		{
+			s_Hooks.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+void *BenchSourceHook::FindHook(const char *name, void *iface)
+{
+	for (const BenchHook &hook : s_Hooks)
+	{
+		if (hook.name == name && hook.iface == iface)
+			return hook.handler;
+	}
+	return nullptr;
+}
+
+//
+// BenchPluginFunction
+//
+
+int BenchPluginFunction::PushCell(cell_t cell)
+{
+	m_params[m_iParams++ % std::size(m_params)] = cell;
+	return 0;
+}
+
+int BenchPluginFunction::PushCellByRef(cell_t *cell, int flags)
+{
+	m_pValue = cell;
+	return PushCell(*cell);
+}
+
+int BenchPluginFunction::PushFloatByRef(float *number, int flags)
+{
+	return PushCellByRef(reinterpret_cast<cell_t *>(number), flags);
+}
+
+int BenchPluginFunction::PushArray(cell_t *inarray, unsigned int cells, int flags)
+{
+	return PushCellByRef(inarray, flags);
+}
+
+int BenchPluginFunction::PushString(const char *string)
+{
+	return PushCell(0);
+}
+
+int BenchPluginFunction::PushStringEx(char *buffer, size_t length, int sz_flags, int cp_flags)
+{
+	return PushCell(0);
+}
+
+// Last param is the client
+int BenchPluginFunction::Execute(cell_t *result)
+{
+	const int client = m_params[(m_iParams - 1) % std::size(m_params)];
+	m_iParams = 0;
+
+	if (m_iGroups == 0 || !m_pValue)
+	{
+		*result = Pl_Continue;
+		return 0;
+	}
+
+	*m_pValue += 1 + client % m_iGroups;
+	*result = Pl_Changed;
+	return 0;
+}
+
+//
+// Nested send tables, laid out as BEGIN_SEND_TABLE, SendPropDataTable and SendPropArray do
+//
+
+// Sends the table from the object pointed to, as the game rules proxy entity sends the game rules
+static void *SendProxy_SharedDataTable(const SendProp *pProp, const void *pStructBase, const void *pData, CSendProxyRecipients *pRecipients, int objectID)
+{
+	return *static_cast<BenchNestedEntity::SharedData *const *>(pData);
+}
+
+static SendProp BenchSendPropInt(const char *name, int offset, int flags = 0)
+{
+	SendProp prop;
+	prop.m_Type = DPT_Int;
+	prop.m_pVarName = name;
+	prop.m_Flags = flags;
+	prop.m_ProxyFn = &SendProxy_Int32ToInt32;
+	prop.m_Offset = offset;
+	return prop;
+}
+
+static SendProp BenchSendPropDataTable(const char *name, int offset, SendTable *pTable, SendTableProxyFn fn = &SendProxy_DataTableToDataTable)
+{
+	SendProp prop;
+	prop.m_Type = DPT_DataTable;
+	prop.m_pVarName = name;
+	prop.m_DataTableProxyFn = fn;
+	prop.m_pDataTable = pTable;
+	prop.m_Offset = offset;
+	return prop;
+}
+
+static SendProp s_LocalProps[] = {
+	BenchSendPropInt("m_iUnused", offsetof(BenchNestedEntity::LocalData, m_iUnused)),
+	BenchSendPropInt("m_iLocal", offsetof(BenchNestedEntity::LocalData, m_iLocal)),
+};
+static SendTable s_LocalTable{ s_LocalProps, static_cast<int>(std::size(s_LocalProps)), "DT_BenchLocal" };
+
+static SendProp s_SharedProps[] = {
+	BenchSendPropInt("m_iUnused", offsetof(BenchNestedEntity::SharedData, m_iUnused)),
+	BenchSendPropInt("m_iShared", offsetof(BenchNestedEntity::SharedData, m_iShared)),
+};
+static SendTable s_SharedTable{ s_SharedProps, static_cast<int>(std::size(s_SharedProps)), "DT_BenchShared" };
+
+static SendProp s_NestedBaseProps[] = {
+	BenchSendPropInt("m_iBase", offsetof(BenchNestedEntity, m_iBase)),
+	BenchSendPropDataTable("m_Local", offsetof(BenchNestedEntity, m_Local), &s_LocalTable),
+};
+static SendTable s_NestedBaseTable{ s_NestedBaseProps, static_cast<int>(std::size(s_NestedBaseProps)), "DT_BenchNestedBase" };
+
+static SendProp s_NestedProps[] = {
+	BenchSendPropDataTable("baseclass", 0, &s_NestedBaseTable),
+	BenchSendPropInt("m_iArray", offsetof(BenchNestedEntity, m_iArray), SPROP_INSIDEARRAY),
+	SendProp(),	// array of the prop above, set up below
+	BenchSendPropDataTable("m_pShared", offsetof(BenchNestedEntity, m_pShared), &s_SharedTable, &SendProxy_SharedDataTable),
+};
+static SendTable s_NestedTable{ s_NestedProps, static_cast<int>(std::size(s_NestedProps)), "DT_BenchNested" };
+
+std::vector<BenchEncodedProp> MockServer::EncodeNestedEntity()
+{
+	std::vector<BenchEncodedProp> props;
+	Engine_EncodeTable(m_nestedClass.m_pTable, &m_nestedEntity, 0, [&](const SendProp *pProp, const void *pStructBase, const void *pData, int element)
+		{
+			props.push_back({ pProp, element, pData });
+		});
+
+	return props;
+}
+
+//
+// MockServer
+//
+
+void MockServer::Init(const MockServerConfig &config)
+{
+	m_config = config;
+	m_config.entities = std::clamp(m_config.entities, m_config.clients + 1, MAX_EDICTS);
+	m_config.props = std::clamp(m_config.props, 1, MAX_BENCH_PROPS);
+	m_iTickCount = 0;
+
+	m_propNames.resize(m_config.props);
+	m_props.resize(m_config.props);
+	m_entities.resize(m_config.entities);
+	for (int i = 0; i < m_config.props; ++i)
+	{
+		m_propNames[i] = "m_iBenchProp" + std::to_string(i);
+
+		SendProp &prop = m_props[i];
+		prop.m_Type = DPT_Int;
+		prop.m_pVarName = m_propNames[i].c_str();
+		prop.m_ProxyFn = &SendProxy_Int32ToInt32;
+		prop.m_Offset = static_cast<int>(reinterpret_cast<uint8_t *>(&m_entities[0].m_Props[i]) - reinterpret_cast<uint8_t *>(&m_entities[0]));
+	}
+
+	m_sendTable.m_pProps = m_props.data();
+	m_sendTable.m_nProps = m_config.props;
+	m_sendTable.m_pNetTableName = "DT_BenchEntity";
+
+	m_serverClass.m_pNetworkName = "CBenchEntity";
+	m_serverClass.m_pTable = &m_sendTable;
+	m_serverClass.m_ClassID = 0;
+
+	// InternalSendPropArray, the array prop is the one right before
+	SendProp &array = s_NestedProps[2];
+	array.m_Type = DPT_Array;
+	array.m_pVarName = "m_iArray";
+	array.m_pArrayProp = &s_NestedProps[1];
+	array.m_nElements = static_cast<int>(std::size(m_nestedEntity.m_iArray));
+	array.m_ElementStride = sizeof(m_nestedEntity.m_iArray[0]);
+
+	m_nestedClass.m_pNetworkName = "CBenchNested";
+	m_nestedClass.m_pTable = &s_NestedTable;
+	m_nestedClass.m_ClassID = 1;
+
+	m_nestedEntity.m_iBase = 1;
+	m_nestedEntity.m_Local = { 2, 3 };
+	for (int i = 0; i < static_cast<int>(std::size(m_nestedEntity.m_iArray)); ++i)
+		m_nestedEntity.m_iArray[i] = 10 + i;
+	m_sharedData = { 4, 5 };
+	m_nestedEntity.m_pShared = &m_sharedData;
+
+	m_edicts.assign(m_config.entities, edict_t());
+	for (int i = 0; i < m_config.entities; ++i)
+	{
+		m_entities[i].m_pServerClass = &m_serverClass;
+		m_edicts[i].m_pUnk = &m_entities[i];
+		m_edicts[i].m_NetworkSerialNumber = i;
+		m_edicts[i].StateChanged();
+	}
+	s_GameHelpers.m_pEdicts = &m_edicts;
+
+	m_clients.assign(m_config.clients, BenchGameClient());
+	m_clientPtrs.resize(m_config.clients);
+	for (int i = 0; i < m_config.clients; ++i)
+	{
+		m_clients[i].m_Client.m_nPlayerSlot = i;
+		m_clientPtrs[i] = &m_clients[i];
+		Assert(GetClients()[i]->GetPlayerSlot() == i);
+	}
+
+	for (EngineFunction &func : s_EngineFunctions)
+		func.current = func.original;
+
+	m_pSnapshotManager = std::make_unique<CFrameSnapshotManager>();
+	framesnapshotmanager = m_pSnapshotManager.get();
+	CFrameSnapshotManager::s_callCreateEmptySnapshot = new CreateEmptySnapshotCall;
+	CFrameSnapshotManager::s_callRemoveEntityReference = new RemoveEntityReferenceCall;
+	CFrameSnapshot::s_callReleaseReference = new ReleaseReferenceCall;
+
+	serverGameEnts = &s_ServerGameEnts;
+	gameents = serverGameEnts;
+	sv_parallel_packentities = &s_sv_parallel_packentities;
+	g_ppLocalNetworkBackdoor = &s_pLocalNetworkBackdoor;
+}
+
+void MockServer::Shutdown()
+{
+	for (BenchGameClient &client : m_clients)
+	{
+		if (client.m_Client.m_pFrameSnapshot)
+			ReleaseReference(client.m_Client.m_pFrameSnapshot);
+		client.m_Client.m_pFrameSnapshot = nullptr;
+	}
+
+	for (int i = 0; i < m_config.entities; ++i)
+	{
+		if (framesnapshotmanager->m_pLastPackedData[i] != INVALID_PACKED_ENTITY_HANDLE)
+			Engine_RemoveEntityReference(framesnapshotmanager, framesnapshotmanager->m_pLastPackedData[i]);
+		framesnapshotmanager->m_pLastPackedData[i] = INVALID_PACKED_ENTITY_HANDLE;
+	}
+
+	if (framesnapshotmanager->m_PackedEntities.Count() != 0)
+		g_pSM->LogError(myself, "%d packed entities leaked", framesnapshotmanager->m_PackedEntities.Count());
+
+	CFrameSnapshotManager::s_callCreateEmptySnapshot->Destroy();
+	CFrameSnapshotManager::s_callRemoveEntityReference->Destroy();
+	CFrameSnapshot::s_callReleaseReference->Destroy();
+	framesnapshotmanager = nullptr;
+	m_pSnapshotManager.reset();
+}
+
+void MockServer::RunTick()
+{
+	++m_iTickCount;
+
+	const uint32_t changed = static_cast<uint32_t>(m_config.changed * 65536.0f);
+	for (int i = 0; i < m_config.entities; ++i)
+	{
+		if ((Random() & 0xFFFF) < changed)
+		{
+			++m_entities[i].m_Props[Random() % m_config.props];
+			m_edicts[i].StateChanged();
+		}
+	}
+
+	CFrameSnapshot *snapshot = Engine_TakeTickSnapshot(m_iTickCount, m_config.entities);
+	SV_ComputeClientPacks(m_config.clients, GetClients(), snapshot);
+	ReleaseReference(snapshot);
+}
+
+// Stable for a few ticks, so that entities come and go as clients move around
+bool MockServer::IsVisible(int client, int entity) const
+{
+	if (entity == 0 || entity == client + 1)
+		return true;
+
+	uint32_t hash = static_cast<uint32_t>(entity) * 2654435761u ^ static_cast<uint32_t>(client) * 40503u ^ static_cast<uint32_t>(m_iTickCount / 8) * 97u;
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6Du;
+	hash ^= hash >> 12;
+	return (hash % 1000) < static_cast<uint32_t>(m_config.visible * 1000.0f);
+}
+
+uint32_t MockServer::Random()
+{
+	m_iRandomState ^= m_iRandomState << 13;
+	m_iRandomState ^= m_iRandomState >> 17;
+	m_iRandomState ^= m_iRandomState << 5;
+	return m_iRandomState;
+}
@@ -0,0 +1,168 @@
+#ifndef _MOCK_ENGINE_H
+#define _MOCK_ENGINE_H
+
+#include "extension.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Int props of the entities, sent by the stand-in of SendProxy_Int32ToInt32
+constexpr int MAX_BENCH_PROPS = 64;
+
+class BenchEntity : public IServerUnknown, public IServerNetworkable
+{
+public:
+	IServerNetworkable *GetNetworkable() override { return this; }
+	ServerClass *GetServerClass() override { return m_pServerClass; }
+
+	ServerClass *m_pServerClass{nullptr};
+	int m_Props[MAX_BENCH_PROPS]{};
+};
+
+// Sent through nested tables, an old style array and a table proxy of its own, only resolved and
+// encoded to check the offsets hooks read the props at
+class BenchNestedEntity
+{
+public:
+	struct LocalData
+	{
+		int m_iUnused;
+		int m_iLocal;
+	};
+
+	struct SharedData
+	{
+		int m_iUnused;
+		int m_iShared;
+	};
+
+	int m_iBase{0};
+	LocalData m_Local{};				// DT_BenchLocal, inside the table of the base class
+	int m_iArray[4]{};					// SendPropArray, the array prop holds the offset
+	SharedData *m_pShared{nullptr};		// DT_BenchShared, sent from the object pointed to as game rules are
+};
+
+// Prop of the nested entity handed to its proxy by the encoder
+struct BenchEncodedProp
+{
+	const SendProp *pProp;
+	int element;
+	const void *pData;
+};
+
+class BenchClient : public IClient
+{
+public:
+	int GetPlayerSlot() const override { return m_nPlayerSlot; }
+
+	int m_nPlayerSlot{0};
+	CBitVec<MAX_EDICTS> m_TransmitEdict;		// transmit_entity of the current frame
+	CFrameSnapshot *m_pFrameSnapshot{nullptr};	// referenced by the current frame
+};
+
+// The engine's CGameClient starts with the 4 byte vtable of IGameEventListener2,
+// CGameClient::GetPlayerSlot reads the IClient right after it.
+#pragma pack(push, 4)
+class BenchGameClient
+{
+public:
+	int m_iGameEventListener{0};
+	BenchClient m_Client;
+};
+#pragma pack(pop)
+
+struct MockServerConfig
+{
+	int entities{512};		// edicts, the first ones are the world and the players
+	int clients{16};
+	int props{16};			// int props of each entity
+	float visible{0.7f};	// fraction of the entities each client transmits
+	float changed{0.1f};	// fraction of the entities whose props change each tick
+};
+
+// Just enough of the engine's snapshot manager and client packing to run the detours
+// the way the game does: SV_ComputeClientPacks, PackEntities_Normal, SV_PackEntity and
+// the CFrameSnapshotManager functions all go through the detourable function table.
+class MockServer
+{
+public:
+	void Init(const MockServerConfig &config);
+	void Shutdown();
+
+	// Changes props of some entities, takes a snapshot and packs it for every client
+	void RunTick();
+
+	int GetNumEntities() const { return m_config.entities; }
+	int GetNumClients() const { return m_config.clients; }
+	int GetNumProps() const { return m_config.props; }
+	int GetTickCount() const { return m_iTickCount; }
+
+	BenchEntity *GetEntity(int index) { return &m_entities[index]; }
+	SendProp *GetProp(int index) { return &m_props[index]; }
+	int GetPropOffset(int index) const { return m_props[index].GetOffset(); }
+	ServerClass *GetServerClass() { return &m_serverClass; }
+	ServerClass *GetNestedServerClass() { return &m_nestedClass; }
+	BenchNestedEntity *GetNestedEntity() { return &m_nestedEntity; }
+	CGameClient **GetClients() { return reinterpret_cast<CGameClient **>(m_clientPtrs.data()); }
+
+	// Whether a client transmits an entity this tick, as decided by the mock CheckTransmit
+	bool IsVisible(int client, int entity) const;
+
+	// Encodes the nested entity as the engine does, with the data each prop proxy gets
+	std::vector<BenchEncodedProp> EncodeNestedEntity();
+
+private:
+	uint32_t Random();
+
+	MockServerConfig m_config;
+	int m_iTickCount{0};
+	uint32_t m_iRandomState{0x2545F491};
+
+	std::unique_ptr<CFrameSnapshotManager> m_pSnapshotManager;
+	std::vector<edict_t> m_edicts;
+	std::vector<BenchEntity> m_entities;
+	std::vector<BenchGameClient> m_clients;
+	std::vector<BenchGameClient *> m_clientPtrs;
+
+	ServerClass m_serverClass;
+	SendTable m_sendTable;
+	std::vector<SendProp> m_props;
+	std::vector<std::string> m_propNames;
+
+	ServerClass m_nestedClass;
+	BenchNestedEntity m_nestedEntity;
+	BenchNestedEntity::SharedData m_sharedData{};
+};
+
+extern MockServer g_MockServer;
+
+// Original proxy of the props, what the hooked proxies end up calling
+void SendProxy_Int32ToInt32(const SendProp *pProp, const void *pStruct, const void *pData, DVariant *pOut, int iElement, int objectID);
+
+// Default proxy of the datatables, sends a table from the data at its offset
+void *SendProxy_DataTableToDataTable(const SendProp *pProp, const void *pStructBase, const void *pData, CSendProxyRecipients *pRecipients, int objectID);
+
+// Plugin callback overriding int props, through the same push/execute sequence as SourcePawn
+class BenchPluginFunction : public IPluginFunction
+{
+public:
+	// Each client gets one of numGroups distinct overrides, 0 to leave the value alone
+	explicit BenchPluginFunction(int numGroups) : m_iGroups(numGroups) {}
+
+	int PushCell(cell_t cell) override;
+	int PushCellByRef(cell_t *cell, int flags) override;
+	int PushFloatByRef(float *number, int flags) override;
+	int PushArray(cell_t *inarray, unsigned int cells, int flags) override;
+	int PushString(const char *string) override;
+	int PushStringEx(char *buffer, size_t length, int sz_flags, int cp_flags) override;
+	int Execute(cell_t *result) override;
+	IPluginRuntime *GetParentRuntime() override { return nullptr; }
+
+private:
+	int m_iGroups;
+	cell_t m_params[8]{};
+	cell_t *m_pValue{nullptr};
+	int m_iParams{0};
+};
+
+#endif
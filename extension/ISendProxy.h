@@ -31,6 +31,13 @@
 
 #ifndef _INCLUDE_ISENDPROXY_
 #define _INCLUDE_ISENDPROXY_
+
+#include <IShareSys.h>
+
+#define SMINTERFACE_SENDPROXY_NAME		"ISendProxyManager"
+#define SMINTERFACE_SENDPROXY_VERSION	1
+
+class SendProp;
  
 enum class PropType : uint8_t
 {
@@ -42,4 +49,84 @@ enum class PropType : uint8_t
 	Prop_Max
 };
 
-#endif
\ No newline at end of file
+namespace SourceMod
+{
+	/**
+	 * @brief Native hook on a prop of an entity.
+	 */
+	class ISendProxyCallback
+	{
+	public:
+		/**
+		 * @brief Called for each client before the entity is packed for them, on the main thread.
+		 *
+		 * @param entity		Entity index.
+		 * @param pProp			Hooked prop, the array element prop for arrays.
+		 * @param type			Type of the value.
+		 * @param pValue		Value the client is about to receive, to be modified in place:
+		 *						int for Prop_Int, float for Prop_Float, float[3] for Prop_Vector,
+		 *						CBaseHandle for Prop_EHandle and a char buffer of
+		 *						DT_MAX_STRING_BUFFERSIZE bytes for Prop_String.
+		 * @param element		Element index for arrays and datatables.
+		 * @param client		Client index.
+		 * @return				True if pValue was changed, false to leave it untouched.
+		 */
+		virtual bool OnSendProxy(int entity, const SendProp *pProp, PropType type, void *pValue, int element, int client) = 0;
+	};
+
+	/**
+	 * @brief Lets extensions hook props without going through SourcePawn.
+	 *
+	 * Hooks are not removed when the owning extension unloads, call UnhookAll() from SDK_OnUnload.
+	 */
+	class ISendProxyManager : public SMInterface
+	{
+	public:
+		const char *GetInterfaceName() override
+		{
+			return SMINTERFACE_SENDPROXY_NAME;
+		}
+		unsigned int GetInterfaceVersion() override
+		{
+			return SMINTERFACE_SENDPROXY_VERSION;
+		}
+
+	public:
+		/**
+		 * @brief Hooks a prop of an entity.
+		 *
+		 * @param pOwner		Extension owning the hook.
+		 * @param entity		Entity index.
+		 * @param propname		Prop name.
+		 * @param type			Type of the prop.
+		 * @param element		Element index for arrays and datatables.
+		 * @param pCallback		Callback to call.
+		 * @param error			Error buffer, filled on failure.
+		 * @param maxlength		Size of error buffer.
+		 * @return				True on success (or if already hooked), false otherwise.
+		 */
+		virtual bool HookEntity(IExtension *pOwner, int entity, const char *propname, PropType type, int element,
+			ISendProxyCallback *pCallback, char *error, size_t maxlength) = 0;
+
+		/**
+		 * @brief Removes a hook made with HookEntity().
+		 *
+		 * @return				True if the hook was found, false otherwise.
+		 */
+		virtual bool UnhookEntity(int entity, const char *propname, int element, ISendProxyCallback *pCallback) = 0;
+
+		/**
+		 * @brief Returns whether a prop of an entity is hooked by a callback.
+		 */
+		virtual bool IsEntityHooked(int entity, const char *propname, int element, ISendProxyCallback *pCallback) = 0;
+
+		/**
+		 * @brief Removes all hooks owned by an extension.
+		 *
+		 * @param pOwner		Extension owning the hooks.
+		 */
+		virtual void UnhookAll(IExtension *pOwner) = 0;
+	};
+}
+
+#endif
\ No newline at end of file
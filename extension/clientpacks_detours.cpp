@@ -1,10 +1,14 @@
 #include "clientpacks_detours.h"
 #include "sendprop_hookmanager.h"
+#include "sendproxy_stats.h"
 #include "CDetour/detours.h"
 #include "iclient.h"
-#include <unordered_map>
 #include <array>
 #include <bitset>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <algorithm>
 
 #if defined(DEBUG) || defined(_DEBUG)
 #define DEBUG_SENDPROXY_MEMORY
@@ -15,21 +19,242 @@ DECL_DETOUR(CFrameSnapshotManager_GetPreviouslySentPacket);
 DECL_DETOUR(CFrameSnapshotManager_CreatePackedEntity);
 DECL_DETOUR(PackEntities_Normal);
 DECL_DETOUR(SV_ComputeClientPacks);
+DECL_DETOUR(CFrameSnapshot_ReleaseReference);
 
-volatile int g_iCurrentClientIndexInLoop = -1; //used for optimization
+SH_DECL_HOOK3_void(IServerGameEnts, CheckTransmit, SH_NOATTRIB, 0, CCheckTransmitInfo *, const unsigned short *, int);
 
-struct PackedEntityInfo
+// Slot of the client whose hooked entities are being packed, -1 otherwise.
+// Not thread-local on purpose: with parallel packing the engine's job threads pack
+// entities of the same client pass and must all see it. Only written between passes.
+int g_iCurrentClientIndexInLoop = -1;
+
+ConVar sm_sendproxy_parallel_pack("sm_sendproxy_parallel_pack", "0", FCVAR_NONE,
+	"Let the engine pack hooked entities on its job threads (sv_parallel_packentities).",
+	true, 0.0f, true, 1.0f);
+
+struct PackedEntityState
 {
-	PackedEntityInfo()
+	PackedEntityState() { updatebits.set(); }
+
+	std::bitset<MAX_PACK_SLOTS> updatebits;
+	bool shared{false};	// packed once for all clients last tick
+};
+
+// Last packed entity of each hooked entity for each pack slot. Hooked entities get a dense row
+// through a MAX_EDICTS table, and the handles of a slot are a contiguous column over the rows,
+// only allocated while the slot is in use.
+class EntityPackTable
+{
+public:
+	EntityPackTable() { m_rows.fill(-1); }
+
+	bool Contains(int entity) const { return m_rows[entity] != -1; }
+
+	PackedEntityHandle_t &Handle(int entity, int slot) { return m_columns[slot][m_rows[entity]]; }
+	PackedEntityState &State(int entity) { return m_states[m_rows[entity]]; }
+
+	void AddEntity(int entity)
+	{
+		m_rows[entity] = static_cast<int>(m_entities.size());
+		m_entities.push_back(entity);
+		m_states.emplace_back();
+
+		for (int slot = 0; slot < MAX_PACK_SLOTS; ++slot)
+		{
+			if (m_activeSlots[slot])
+				m_columns[slot].push_back(INVALID_PACKED_ENTITY_HANDLE);
+		}
+	}
+
+	// Releases the handle of the entity in a slot, so that it is packed from scratch there
+	void ResetHandle(int entity, int slot)
 	{
-		handles.fill(INVALID_PACKED_ENTITY_HANDLE);
-		updatebits.set();
+		if (!m_activeSlots[slot])
+			return;
+
+		PackedEntityHandle_t &handle = m_columns[slot][m_rows[entity]];
+		if (handle != INVALID_PACKED_ENTITY_HANDLE)
+		{
+			framesnapshotmanager->ReleaseEntityReference(handle);
+			handle = INVALID_PACKED_ENTITY_HANDLE;
+		}
 	}
 
-	std::array<PackedEntityHandle_t, MAXPLAYERS> handles;
-	std::bitset<MAXPLAYERS> updatebits;
+	// Releases the handles of the entity, the last row takes its place
+	void RemoveEntity(int entity)
+	{
+		const int row = m_rows[entity];
+		const int last = static_cast<int>(m_entities.size()) - 1;
+
+		for (int slot = 0; slot < MAX_PACK_SLOTS; ++slot)
+		{
+			if (!m_activeSlots[slot])
+				continue;
+
+			std::vector<PackedEntityHandle_t> &column = m_columns[slot];
+			if (column[row] != INVALID_PACKED_ENTITY_HANDLE)
+				framesnapshotmanager->ReleaseEntityReference(column[row]);
+
+			column[row] = column[last];
+			column.pop_back();
+		}
+
+		m_states[row] = m_states[last];
+		m_states.pop_back();
+
+		m_entities[row] = m_entities[last];
+		m_rows[m_entities[row]] = row;
+		m_entities.pop_back();
+		m_rows[entity] = -1;
+	}
+
+	// Allocates the column of a slot about to be packed
+	void UseSlot(int slot)
+	{
+		if (m_activeSlots[slot])
+			return;
+
+		m_activeSlots[slot] = true;
+		m_columns[slot].assign(m_entities.size(), INVALID_PACKED_ENTITY_HANDLE);
+		for (PackedEntityState &state : m_states)
+			state.updatebits[slot] = true;
+	}
+
+	// Releases the handles of a slot in one pass over its column and frees it
+	void ReleaseSlot(int slot)
+	{
+		if (!m_activeSlots[slot])
+			return;
+
+		framesnapshotmanager->ReleaseEntityReferences(m_columns[slot].data(), static_cast<int>(m_columns[slot].size()));
+
+		m_activeSlots[slot] = false;
+		m_columns[slot].clear();
+		m_columns[slot].shrink_to_fit();
+	}
+
+	// Forgets everything without releasing, on level change the engine drops the packed entities itself
+	void Clear()
+	{
+		m_rows.fill(-1);
+		m_entities.clear();
+		m_states.clear();
+		for (auto &column : m_columns)
+			column.clear();
+		m_activeSlots.reset();
+	}
+
+private:
+	std::array<int, MAX_EDICTS> m_rows;
+	std::vector<int> m_entities;	// by row
+	std::vector<PackedEntityState> m_states;	// by row
+	std::array<std::vector<PackedEntityHandle_t>, MAX_PACK_SLOTS> m_columns;
+	std::bitset<MAX_PACK_SLOTS> m_activeSlots;
 };
-std::unordered_map<int, PackedEntityInfo> g_EntityPackMap;
+EntityPackTable g_EntityPackTable;
+
+// Recycles the per-client snapshot arrays, which would otherwise be allocated for every
+// extra client each tick and freed by the engine along with the snapshot.
+// Buffers come from the same allocator as the engine's, so whatever we lose track of
+// is still freed properly by the engine.
+template <typename T>
+class SnapshotBufferPool
+{
+public:
+	T *Alloc()
+	{
+		if (m_free.empty())
+		{
+			++m_nMisses;
+			return new T[MAX_EDICTS];
+		}
+
+		++m_nHits;
+		T *buffer = m_free.back();
+		m_free.pop_back();
+		return buffer;
+	}
+
+	void Free(T *buffer) { m_free.push_back(buffer); }
+
+	void Purge()
+	{
+		for (T *buffer : m_free)
+			delete[] buffer;
+		m_free.clear();
+	}
+
+	int GetHits() const { return m_nHits; }
+	int GetMisses() const { return m_nMisses; }
+
+private:
+	std::vector<T *> m_free;
+	int m_nHits{0};
+	int m_nMisses{0};
+};
+
+SnapshotBufferPool<unsigned short> g_ValidEntitiesPool;
+SnapshotBufferPool<CHLTVEntityData> g_HLTVEntityDataPool;
+
+// Client snapshots alive with pooled buffers, sorted by snapshot.
+// An entry outlives its snapshot if the engine deletes it without ReleaseReference,
+// so the address alone does not make a snapshot ours, the tick and buffers must match too.
+struct PooledSnapshot
+{
+	CFrameSnapshot *snapshot;
+	int tickCount;
+	unsigned short *validEntities;
+	CHLTVEntityData *hltvData;
+
+	bool operator<(const CFrameSnapshot *other) const { return snapshot < other; }
+
+	bool IsOwnerOf(const CFrameSnapshot *other) const
+	{
+		return snapshot == other && tickCount == other->m_nTickCount && validEntities == other->m_pValidEntities;
+	}
+};
+std::vector<PooledSnapshot> g_PooledSnapshots;
+
+// Snapshots may be released from the engine's job threads, this guards
+// g_PooledSnapshots and the free lists of the pools
+std::mutex g_PooledSnapshotsMutex;
+
+// For each per-client hooked entity, then each client of the pass, the first client
+// of the pass that receives the same overrides. Rebuilt every tick.
+std::vector<uint8_t> g_PackLeaders;
+
+struct SharedPack
+{
+	int entity;
+	int leader;
+};
+std::vector<SharedPack> g_SharedPacks;
+std::vector<unsigned short> g_SkippedPacks;
+
+// Entities each client of the pass transmits this tick, by client loop index,
+// captured from CheckTransmit while setting up the client packs
+std::array<CBitVec<MAX_EDICTS>, MAXPLAYERS> g_ClientTransmits;
+std::bitset<MAXPLAYERS> g_ClientTransmitsCaptured;
+static int g_iSetupClientIndex = -1;
+
+// Leader of a client that does not transmit the entity, it is not evaluated for it and the engine skips it while packing
+constexpr uint8_t NOT_TRANSMITTED = 0xFF;
+
+static bool IsTransmitted(int clientIndex, int edictidx)
+{
+	return !g_ClientTransmitsCaptured[clientIndex] || g_ClientTransmits[clientIndex].IsBitSet(edictidx);
+}
+
+static void Hook_CheckTransmit(CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts)
+{
+	if (g_iSetupClientIndex != -1 && pInfo->m_pTransmitEdict)
+	{
+		g_ClientTransmits[g_iSetupClientIndex] = *pInfo->m_pTransmitEdict;
+		g_ClientTransmitsCaptured[g_iSetupClientIndex] = true;
+	}
+
+	RETURN_META(MRES_IGNORED);
+}
 
 /*Call stack:
 	...
@@ -46,7 +271,7 @@ DETOUR_DECL_MEMBER3(CFrameSnapshotManager_UsePreviouslySentPacket, bool, CFrameS
 {
 	if (g_iCurrentClientIndexInLoop != -1)
 	{
-		framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackMap.at(entity).handles[g_iCurrentClientIndexInLoop];
+		framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackTable.Handle(entity, g_iCurrentClientIndexInLoop);
 	}
 
 	return DETOUR_MEMBER_CALL(CFrameSnapshotManager_UsePreviouslySentPacket)(pSnapshot, entity, entSerialNumber);
@@ -56,7 +281,7 @@ DETOUR_DECL_MEMBER2(CFrameSnapshotManager_GetPreviouslySentPacket, PackedEntity*
 {
 	if (g_iCurrentClientIndexInLoop != -1)
 	{
-		framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackMap.at(entity).handles[g_iCurrentClientIndexInLoop];
+		framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackTable.Handle(entity, g_iCurrentClientIndexInLoop);
 	}
 
 	return DETOUR_MEMBER_CALL(CFrameSnapshotManager_GetPreviouslySentPacket)(entity, entSerialNumber);
@@ -69,17 +294,50 @@ DETOUR_DECL_MEMBER2(CFrameSnapshotManager_CreatePackedEntity, PackedEntity*, CFr
 		return DETOUR_MEMBER_CALL(CFrameSnapshotManager_CreatePackedEntity)(pSnapshot, entity);
 	}
 
-	framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackMap.at(entity).handles[g_iCurrentClientIndexInLoop];
+	framesnapshotmanager->m_pLastPackedData[entity] = g_EntityPackTable.Handle(entity, g_iCurrentClientIndexInLoop);
 
 	PackedEntity *result = DETOUR_MEMBER_CALL(CFrameSnapshotManager_CreatePackedEntity)(pSnapshot, entity);
 
-	g_EntityPackMap.at(entity).handles[g_iCurrentClientIndexInLoop] = framesnapshotmanager->m_pLastPackedData[entity];
+	g_EntityPackTable.Handle(entity, g_iCurrentClientIndexInLoop) = framesnapshotmanager->m_pLastPackedData[entity];
 
 	return result;
 }
 
+DETOUR_DECL_MEMBER0(CFrameSnapshot_ReleaseReference, void)
+{
+	CFrameSnapshot *pSnapshot = reinterpret_cast<CFrameSnapshot *>(this);
+
+	// Releases run concurrently on the engine's job threads, only the one whose
+	// decrement drops the last reference may take the buffers back.
+	if (--pSnapshot->m_nReferences != 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(g_PooledSnapshotsMutex);
+
+		auto it = std::lower_bound(g_PooledSnapshots.begin(), g_PooledSnapshots.end(), pSnapshot);
+		if (it != g_PooledSnapshots.end() && it->IsOwnerOf(pSnapshot))
+		{
+			g_ValidEntitiesPool.Free(it->validEntities);
+			pSnapshot->m_pValidEntities = nullptr;
+
+			if (it->hltvData && pSnapshot->m_pHLTVEntityData == it->hltvData)
+			{
+				g_HLTVEntityDataPool.Free(it->hltvData);
+				pSnapshot->m_pHLTVEntityData = nullptr;
+			}
+
+			g_PooledSnapshots.erase(it);
+		}
+	}
+
+	// Nobody else holds it anymore, hand the last reference back for the engine to delete it
+	++pSnapshot->m_nReferences;
+	DETOUR_MEMBER_CALL(CFrameSnapshot_ReleaseReference)();
+}
+
 static void CopyFrameSnapshot(CFrameSnapshot *dest, const CFrameSnapshot *src);
-static void CopyPackedEntities(CFrameSnapshot *dest, const CFrameSnapshot *src);
+static void CopyPackedEntities(CFrameSnapshot **dest, int count, const CFrameSnapshot *src, int numUnhooked);
 static bool g_bSetupClientPacks = false;
 
 DETOUR_DECL_STATIC3(PackEntities_Normal, void, int, iClientCount, CGameClient **, pClients, CFrameSnapshot *, pSnapShot)
@@ -90,10 +348,87 @@ DETOUR_DECL_STATIC3(PackEntities_Normal, void, int, iClientCount, CGameClient **
 	return DETOUR_STATIC_CALL(PackEntities_Normal)(iClientCount, pClients, pSnapShot);
 }
 
+// Packs a range of the hooked entities of a snapshot for the current pack slot.
+// The last numSkipped entities of the range were not evaluated as the client does not
+// transmit them, the engine skips them too and their update bits are kept for later.
+static void PackHookedEntities(int iClientCount, CGameClient **pClients, CFrameSnapshot *snapshot, int first, int count, int numSkipped = 0)
+{
+	const int numEntities = snapshot->m_nValidEntities;
+
+	snapshot->m_pValidEntities += first;
+	snapshot->m_nValidEntities = count;
+
+	std::for_each_n(snapshot->m_pValidEntities,
+					count - numSkipped,
+					[](int edictidx)
+					{
+						std::bitset<MAX_PACK_SLOTS> &updatebits = g_EntityPackTable.State(edictidx).updatebits;
+						if (updatebits[g_iCurrentClientIndexInLoop])
+						{
+							updatebits[g_iCurrentClientIndexInLoop] = false;
+							gamehelpers->EdictOfIndex(edictidx)->m_fStateFlags |= FL_EDICT_CHANGED;
+							g_SendProxyStats.Increment(StatCounter::StateChangesForced);
+						}
+					});
+
+	DETOUR_STATIC_CALL(PackEntities_Normal)(iClientCount, pClients, snapshot);
+
+	snapshot->m_nValidEntities = numEntities;
+	snapshot->m_pValidEntities -= first;
+}
+
+// Moves the hooked entities to the back, keeping the engine's order on both sides.
+// Both cursors always advance by the membership bit, so nothing branches on it.
+static int PartitionHookedEntities(unsigned short *entities, int count, const std::bitset<MAX_EDICTS> &hooked)
+{
+	static unsigned short s_HookedEntities[MAX_EDICTS];
+
+	int numUnhooked = 0;
+	int numHooked = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		const unsigned short edictidx = entities[i];
+		const bool isHooked = hooked[edictidx];
+
+		entities[numUnhooked] = edictidx;	// never ahead of i
+		s_HookedEntities[numHooked] = edictidx;
+		numUnhooked += !isHooked;
+		numHooked += isHooked;
+	}
+
+	std::copy_n(s_HookedEntities, numHooked, entities + numUnhooked);
+	return numHooked;
+}
+
+// Gives a client the entity packed for another client of its group, as if packed for it
+static void ShareHookedPack(CFrameSnapshot *dest, const CFrameSnapshot *src, int entity, int slot)
+{
+	const PackedEntityHandle_t data = src->m_pEntities[entity].m_pPackedData;
+	Assert(data != INVALID_PACKED_ENTITY_HANDLE);
+	if (data == INVALID_PACKED_ENTITY_HANDLE)
+		return;
+
+	dest->m_pEntities[entity].m_pPackedData = data;
+	framesnapshotmanager->AddEntityReference(data);
+
+	PackedEntityHandle_t &handle = g_EntityPackTable.Handle(entity, slot);
+	if (handle != data)
+	{
+		if (handle != INVALID_PACKED_ENTITY_HANDLE)
+			framesnapshotmanager->ReleaseEntityReference(handle);
+
+		handle = data;
+		framesnapshotmanager->AddEntityReference(data);
+	}
+	g_EntityPackTable.State(entity).updatebits[slot] = false;
+
+	g_SendProxyStats.Increment(StatCounter::PacksShared);
+}
+
 DETOUR_DECL_STATIC3(SV_ComputeClientPacks, void, int, iClientCount, CGameClient **, pClients, CFrameSnapshot *, pSnapShot)
 {
 	if (playerhelpers->GetMaxClients() <= 1
-	 || !g_pSendPropHookManager->IsAnyEntityHooked()
+	 || (!g_pSendPropHookManager->IsAnyEntityHooked() && !g_pSendPropHookManager->IsAnyClassHooked())
 	 || *g_ppLocalNetworkBackdoor != nullptr)
 	{
 		static bool isLocalBackdoorEncountered = false;
@@ -108,112 +443,260 @@ DETOUR_DECL_STATIC3(SV_ComputeClientPacks, void, int, iClientCount, CGameClient
 	}
 
 	const int numEntities = pSnapShot->m_nValidEntities;
-	int numHooked = 0;
 
-	// Move all hooked entities to the back
-	for (int i = numEntities-1; i >= 0; --i)
+	// Entities of hooked classes get their hooks before we look for hooked entities
+	if (g_pSendPropHookManager->IsAnyClassHooked())
 	{
-		const auto entindex = pSnapShot->m_pValidEntities[i];
-		if (g_pSendPropHookManager->IsEntityHooked(entindex))
+		std::for_each_n(pSnapShot->m_pValidEntities, numEntities, [pSnapShot](int edictidx)
+			{ g_pSendPropHookManager->UpdateEntityClass(edictidx, pSnapShot->m_pEntities[edictidx].m_pClass); });
+	}
+
+	// Move all hooked entities to the back
+	const int numHooked = PartitionHookedEntities(pSnapShot->m_pValidEntities, numEntities, g_pSendPropHookManager->GetHookedEntities());
+
+	std::for_each_n(pSnapShot->m_pValidEntities + numEntities - numHooked, numHooked, [](int edictidx)
 		{
-			const auto tail = pSnapShot->m_nValidEntities - numHooked - 1;
-			std::swap(pSnapShot->m_pValidEntities[i], pSnapShot->m_pValidEntities[tail]);
-			numHooked++;
+			if (gamehelpers->EdictOfIndex(edictidx)->HasStateChanged())
+			{
+				g_EntityPackTable.State(edictidx).updatebits.set();
+				g_pSendPropHookManager->MarkEntityDirty(edictidx);
+			}
+		});
+
+	// Hooked entities are all dormant or out of every PVS, nothing to pack per client
+	if (numHooked == 0)
+		return DETOUR_STATIC_CALL(SV_ComputeClientPacks)(iClientCount, pClients, pSnapShot);
 
-			if (gamehelpers->EdictOfIndex(entindex)->HasStateChanged())
-				g_EntityPackMap.at(entindex).updatebits.set();
-		}
-	}
+	g_SendProxyStats.BeginTick();
+
+	// Client-invariant entities go first in the hooked tail, they are packed once and shared
+	auto hookedBegin = pSnapShot->m_pValidEntities + numEntities - numHooked;
+	auto sharedEnd = std::partition(hookedBegin, pSnapShot->m_pValidEntities + numEntities,
+		[](int edictidx)
+		{
+			PackedEntityState &info = g_EntityPackTable.State(edictidx);
+			const bool shared = g_pSendPropHookManager->GetEntityHooks(edictidx)->AllHooksHave(SendProxyFlag_ClientInvariant);
+
+			// Switching between shared and per-client handles, everything has to be evaluated and packed again.
+			// The handles of the mode entered were last packed before the previous switch, drop them.
+			if (shared != info.shared)
+			{
+				if (shared)
+				{
+					g_EntityPackTable.ResetHandle(edictidx, SHARED_PACK_SLOT);
+				}
+				else
+				{
+					for (int slot = 0; slot < MAXPLAYERS; ++slot)
+						g_EntityPackTable.ResetHandle(edictidx, slot);
+				}
+
+				info.shared = shared;
+				info.updatebits.set();
+				g_pSendPropHookManager->MarkEntityDirty(edictidx);
+			}
+			return shared;
+		});
+
+	const int numUnhooked = numEntities - numHooked;
+	const int numShared = sharedEnd - hookedBegin;
 
 	// Make snapshots for each client
 	CUtlVector<CFrameSnapshot *> clientSnapshots(0, iClientCount);
 	clientSnapshots[0] = pSnapShot;
-	for (int i = 1; i < iClientCount; ++i)
 	{
-		clientSnapshots[i] = framesnapshotmanager->CreateEmptySnapshot(pSnapShot->m_nTickCount, pSnapShot->m_nNumEntities);
-		CopyFrameSnapshot(clientSnapshots[i], pSnapShot);
+		StatScopedTimer timer(StatTimer::SnapshotCopy);
+
+		for (int i = 1; i < iClientCount; ++i)
+		{
+			clientSnapshots[i] = framesnapshotmanager->CreateEmptySnapshot(pSnapShot->m_nTickCount, pSnapShot->m_nNumEntities);
+			CopyFrameSnapshot(clientSnapshots[i], pSnapShot);
+		}
 	}
 
 	// Setup transmit infos
 	g_bSetupClientPacks = true;
+	g_ClientTransmitsCaptured.reset();
 	for (int i = 0; i < iClientCount; ++i)
 	{
 		CGameClient *client = pClients[i];
 		CFrameSnapshot *snapshot = clientSnapshots[i];
 
+		g_iSetupClientIndex = i;
 		DETOUR_STATIC_CALL(SV_ComputeClientPacks)(1, &client, snapshot);
 	}
+	g_iSetupClientIndex = -1;
 	g_bSetupClientPacks = false;
 
 	// Pack all unhooked entities
 	{
 		g_iCurrentClientIndexInLoop = -1;
 
-		pSnapShot->m_nValidEntities = numEntities - numHooked;
+		StatScopedTimer timer(StatTimer::UnhookedPack);
+
+		pSnapShot->m_nValidEntities = numUnhooked;
 		DETOUR_STATIC_CALL(PackEntities_Normal)(iClientCount, pClients, pSnapShot);
 		pSnapShot->m_nValidEntities = numEntities;
+	}
 
-		for (int i = 1; i < iClientCount; ++i)
-		{
-			CopyPackedEntities(clientSnapshots[i], pSnapShot);
-		}
+	const int numPerClient = numHooked - numShared;
+	std::array<int, MAXPLAYERS> slots;
+	for (int i = 0; i < iClientCount; ++i)
+	{
+		slots[i] = pClients[i]->GetPlayerSlot();
+		g_EntityPackTable.UseSlot(slots[i]);
 	}
+	if (numShared > 0)
+		g_EntityPackTable.UseSlot(SHARED_PACK_SLOT);
 
-	// Pack hooked entities for each client
+	// Hooks removed by callbacks from now on are only purged after packing
+	g_pSendPropHookManager->LockDispatch();
+
+	// Run all callbacks before encoding, the proxies only look up the results
 	{
-		ConVarScopedSet linearpack(sv_parallel_packentities, "0");
+		StatScopedTimer timer(StatTimer::Callbacks);
+
+		std::for_each_n(pSnapShot->m_pValidEntities + numUnhooked,
+						numShared,
+						[](int edictidx)
+						{
+							if (g_pSendPropHookManager->EvaluateEntity(edictidx, 0))
+								g_EntityPackTable.State(edictidx).updatebits[SHARED_PACK_SLOT] = true;
+						});
 
+		// Entities a client does not see this tick are left alone until they come back
 		for (int i = 0; i < iClientCount; ++i)
 		{
-			CGameClient *client = pClients[i];
-			CFrameSnapshot *snapshot = clientSnapshots[i];
-
-			g_iCurrentClientIndexInLoop = client->GetPlayerSlot();
-
-			snapshot->m_pValidEntities += numEntities - numHooked;
-			snapshot->m_nValidEntities = numHooked;
+			const int slot = slots[i];
 
-			std::for_each_n(snapshot->m_pValidEntities,
-							snapshot->m_nValidEntities,
-							[](int edictidx)
+			std::for_each_n(pSnapShot->m_pValidEntities + numUnhooked + numShared,
+							numPerClient,
+							[i, slot](int edictidx)
 							{
-								if (g_EntityPackMap.at(edictidx).updatebits[g_iCurrentClientIndexInLoop])
-								{
-									g_EntityPackMap.at(edictidx).updatebits[g_iCurrentClientIndexInLoop] = false;
-									gamehelpers->EdictOfIndex(edictidx)->m_fStateFlags |= FL_EDICT_CHANGED;
-								}
+								if (IsTransmitted(i, edictidx) && g_pSendPropHookManager->EvaluateEntity(edictidx, slot + 1))
+									g_EntityPackTable.State(edictidx).updatebits[slot] = true;
 							});
+		}
+
+		// Group the clients receiving the same overrides, only the first of each group packs the entity.
+		// The engine packs against the last packed entity of the slot, so a client whose last
+		// packed entity differs from the leader's is on another change chain and packs itself.
+		// Without its transmit set a client may not pack the entity at all, so it never leads nor follows.
+		g_PackLeaders.resize(numPerClient * iClientCount);
+		for (int e = 0; e < numPerClient; ++e)
+		{
+			const int edictidx = pSnapShot->m_pValidEntities[numUnhooked + numShared + e];
+			const SendPropEntityInfo *info = g_pSendPropHookManager->GetEntityHooks(edictidx);
+			uint8_t *leaders = &g_PackLeaders[e * iClientCount];
+
+			std::array<PackedEntityHandle_t, MAXPLAYERS> handles;
+			for (int i = 0; i < iClientCount; ++i)
+				handles[i] = g_EntityPackTable.Handle(edictidx, slots[i]);
+
+			for (int i = 0; i < iClientCount; ++i)
+			{
+				if (!IsTransmitted(i, edictidx))
+				{
+					leaders[i] = NOT_TRANSMITTED;
+					continue;
+				}
+
+				leaders[i] = i;
+				if (!g_ClientTransmitsCaptured[i])
+					continue;
+
+				for (int j = 0; j < i; ++j)
+				{
+					if (leaders[j] == j && g_ClientTransmitsCaptured[j]
+					 && handles[j] == handles[i] && info->HasSameOverrides(slots[j], slots[i]))
+					{
+						leaders[i] = j;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// Pack hooked entities for each client
+	{
+		StatScopedTimer timer(StatTimer::HookedPack);
 
-			DETOUR_STATIC_CALL(PackEntities_Normal)(1, &client, snapshot);
+		// Each entity is packed by exactly one job per pass, so its handle slot
+		// for the current client is never written concurrently.
+		std::optional<ConVarScopedInt> linearpack;
+		if (!sm_sendproxy_parallel_pack.GetBool())
+			linearpack.emplace(sv_parallel_packentities, 0);
 
-			snapshot->m_nValidEntities = numEntities;
-			snapshot->m_pValidEntities -= numEntities - numHooked;
+		// Client-invariant entities are packed once in the main snapshot, as unhooked ones
+		if (numShared > 0)
+		{
+			g_iCurrentClientIndexInLoop = SHARED_PACK_SLOT;
+			PackHookedEntities(iClientCount, pClients, pSnapShot, numUnhooked, numShared);
 		}
+
+		for (int i = 0; numPerClient > 0 && i < iClientCount; ++i)
+		{
+			CGameClient *client = pClients[i];
+			CFrameSnapshot *snapshot = clientSnapshots[i];
+			unsigned short *entities = snapshot->m_pValidEntities + numUnhooked + numShared;
+
+			// Entities this client packs itself go first, then the ones it does not transmit,
+			// left in the packed range for the engine to skip, then the ones it shares with an earlier client
+			g_SharedPacks.clear();
+			g_SkippedPacks.clear();
+			int numPacked = 0;
+			for (int e = 0; e < numPerClient; ++e)
+			{
+				const int leader = g_PackLeaders[e * iClientCount + i];
+				if (leader == NOT_TRANSMITTED)
+					g_SkippedPacks.push_back(entities[e]);
+				else if (leader != i && clientSnapshots[leader]->m_pEntities[entities[e]].m_pPackedData != INVALID_PACKED_ENTITY_HANDLE)
+					g_SharedPacks.push_back({ entities[e], leader });
+				else
+					entities[numPacked++] = entities[e];	// its own group, or the engine skipped it for the leader
+			}
+			const int numSkipped = static_cast<int>(g_SkippedPacks.size());
+			std::copy(g_SkippedPacks.begin(), g_SkippedPacks.end(), entities + numPacked);
+			for (size_t k = 0; k < g_SharedPacks.size(); ++k)
+				entities[numPacked + numSkipped + k] = g_SharedPacks[k].entity;
+			g_SendProxyStats.Increment(StatCounter::PacksSkipped, numSkipped);
+
+			g_iCurrentClientIndexInLoop = slots[i];
+			if (numPacked + numSkipped > 0)
+				PackHookedEntities(1, &client, snapshot, numUnhooked + numShared, numPacked + numSkipped, numSkipped);
+
+			for (const SharedPack &shared : g_SharedPacks)
+				ShareHookedPack(snapshot, clientSnapshots[shared.leader], shared.entity, slots[i]);
+		}
+	}
+
+	// Share everything packed in the main snapshot with the other clients
+	{
+		StatScopedTimer timer(StatTimer::SnapshotCopy);
+		if (iClientCount > 1)
+			CopyPackedEntities(clientSnapshots.Base() + 1, iClientCount - 1, pSnapShot, numUnhooked + numShared);
 	}
 
 	g_iCurrentClientIndexInLoop = -1;
 
+	g_pSendPropHookManager->UnlockDispatch();
+
 	// finally decrement reference of manually created snapshots
 	for (int i = 1; i < iClientCount; ++i)
 	{
 		Assert(clientSnapshots[i]->m_nReferences == 2);
 		clientSnapshots[i]->ReleaseReference();
 	}
-}
 
-int ClientPacksDetour::GetCurrentClientIndex()
-{
-	if (g_iCurrentClientIndexInLoop == -1)
-		return -1;
-
-	return g_iCurrentClientIndexInLoop + 1;
+	g_SendProxyStats.EndTick();
 }
 
 void ClientPacksDetour::OnEntityHooked(int entity)
 {
-	if (g_EntityPackMap.find(entity) == g_EntityPackMap.end())
+	if (!g_EntityPackTable.Contains(entity))
 	{
-		g_EntityPackMap.emplace(entity, PackedEntityInfo());
+		g_EntityPackTable.AddEntity(entity);
 
 		if (framesnapshotmanager->m_pLastPackedData[entity] != INVALID_PACKED_ENTITY_HANDLE)
 		{
@@ -225,34 +708,16 @@ void ClientPacksDetour::OnEntityHooked(int entity)
 
 void ClientPacksDetour::OnEntityUnhooked(int entity)
 {
-	if (g_EntityPackMap.find(entity) == g_EntityPackMap.end())
+	if (!g_EntityPackTable.Contains(entity))
 		return;
 
-	for (PackedEntityHandle_t handle : g_EntityPackMap.at(entity).handles)
-	{
-		if (handle != INVALID_PACKED_ENTITY_HANDLE)
-		{
-			framesnapshotmanager->RemoveEntityReference(handle);
-		}
-	}
-	
-	g_EntityPackMap.erase(entity);
+	g_EntityPackTable.RemoveEntity(entity);
 	framesnapshotmanager->m_pLastPackedData[entity] = INVALID_PACKED_ENTITY_HANDLE;
 }
 
 void ClientPacksDetour::OnClientDisconnected(int client)
 {
-	int index = client - 1;
-
-	for (auto& [_, info] : g_EntityPackMap)
-	{
-		if (info.handles[index] != INVALID_PACKED_ENTITY_HANDLE)
-		{
-			framesnapshotmanager->RemoveEntityReference(info.handles[index]);
-			info.handles[index] = INVALID_PACKED_ENTITY_HANDLE;
-		}
-		info.updatebits[index] = true;
-	}
+	g_EntityPackTable.ReleaseSlot(client - 1);
 }
 
 bool ClientPacksDetour::Init(IGameConfig *gc)
@@ -265,10 +730,17 @@ bool ClientPacksDetour::Init(IGameConfig *gc)
 	CREATE_DETOUR(CFrameSnapshotManager_CreatePackedEntity, "CFrameSnapshotManager::CreatePackedEntity", bDetoursInited);
 	CREATE_DETOUR_STATIC(PackEntities_Normal, "PackEntities_Normal", bDetoursInited);
 	CREATE_DETOUR_STATIC(SV_ComputeClientPacks, "SV_ComputeClientPacks", bDetoursInited);
+	CREATE_DETOUR(CFrameSnapshot_ReleaseReference, "CFrameSnapshot::ReleaseReference", bDetoursInited);
 	
 	if (!bDetoursInited)
 		return false;
 
+	// Without it every hooked entity is packed for every client, as if transmitted
+	if (gameents)
+		SH_ADD_HOOK(IServerGameEnts, CheckTransmit, gameents, SH_STATIC(Hook_CheckTransmit), true);
+	else
+		LogError("IServerGameEnts not found, hooked entities are evaluated for every client and their packs are not shared between clients.");
+
 	return true;
 }
 
@@ -279,6 +751,16 @@ void ClientPacksDetour::Shutdown()
 	DESTROY_DETOUR(CFrameSnapshotManager_CreatePackedEntity);
 	DESTROY_DETOUR(PackEntities_Normal);
 	DESTROY_DETOUR(SV_ComputeClientPacks);
+	DESTROY_DETOUR(CFrameSnapshot_ReleaseReference);
+
+	if (gameents)
+		SH_REMOVE_HOOK(IServerGameEnts, CheckTransmit, gameents, SH_STATIC(Hook_CheckTransmit), true);
+
+	// Snapshots still alive free their buffers themselves
+	std::lock_guard<std::mutex> lock(g_PooledSnapshotsMutex);
+	g_PooledSnapshots.clear();
+	g_ValidEntitiesPool.Purge();
+	g_HLTVEntityDataPool.Purge();
 }
 
 void ClientPacksDetour::Clear()
@@ -287,44 +769,90 @@ void ClientPacksDetour::Clear()
 	LogMessage("=== PACKED ENTITIES COUNT (%d) ===", framesnapshotmanager->m_PackedEntities.Count());
 #endif
 
-	g_EntityPackMap.clear();
+	g_EntityPackTable.Clear();
+
+	// The engine may delete snapshots without releasing them on level change,
+	// forget about them rather than risk reclaiming a recycled address.
+	std::lock_guard<std::mutex> lock(g_PooledSnapshotsMutex);
+	g_PooledSnapshots.clear();
+}
+
+int ClientPacksDetour::GetPoolHits()
+{
+	return g_ValidEntitiesPool.GetHits() + g_HLTVEntityDataPool.GetHits();
+}
+
+int ClientPacksDetour::GetPoolMisses()
+{
+	return g_ValidEntitiesPool.GetMisses() + g_HLTVEntityDataPool.GetMisses();
 }
 
 static void CopyFrameSnapshot(CFrameSnapshot *dest, const CFrameSnapshot *src)
 {
 	Assert(dest->m_nNumEntities == src->m_nNumEntities);
-	Q_memcpy(dest->m_pEntities, src->m_pEntities, dest->m_nNumEntities * sizeof(CFrameSnapshotEntry));
+
+	{
+		std::lock_guard<std::mutex> lock(g_PooledSnapshotsMutex);
+
+		dest->m_pValidEntities = g_ValidEntitiesPool.Alloc();
+		if (src->m_pHLTVEntityData != NULL)
+		{
+			Assert(dest->m_pHLTVEntityData == NULL);
+			dest->m_pHLTVEntityData = g_HLTVEntityDataPool.Alloc();
+		}
+
+		// An entry at the same address belongs to a snapshot the engine deleted behind our back,
+		// along with its buffers
+		const PooledSnapshot entry{ dest, dest->m_nTickCount, dest->m_pValidEntities, dest->m_pHLTVEntityData };
+		auto it = std::lower_bound(g_PooledSnapshots.begin(), g_PooledSnapshots.end(), dest);
+		if (it != g_PooledSnapshots.end() && it->snapshot == dest)
+			*it = entry;
+		else
+			g_PooledSnapshots.insert(it, entry);
+	}
 
 	dest->m_nValidEntities = src->m_nValidEntities;
-	dest->m_pValidEntities = new unsigned short[dest->m_nValidEntities];
 	Q_memcpy(dest->m_pValidEntities, src->m_pValidEntities, dest->m_nValidEntities * sizeof(unsigned short));
 
-	if (src->m_pHLTVEntityData != NULL)
+	// Only valid entries are filled in, the others stay as CreateEmptySnapshot left them
+	for (int i = 0; i < dest->m_nValidEntities; ++i)
 	{
-		Assert(dest->m_pHLTVEntityData == NULL);
-		dest->m_pHLTVEntityData = new CHLTVEntityData[dest->m_nValidEntities];
-		Q_memset( dest->m_pHLTVEntityData, 0, dest->m_nValidEntities * sizeof(CHLTVEntityData) );
+		const int entindex = dest->m_pValidEntities[i];
+		dest->m_pEntities[entindex] = src->m_pEntities[entindex];
 	}
 
+	if (dest->m_pHLTVEntityData != NULL)
+		Q_memset( dest->m_pHLTVEntityData, 0, dest->m_nValidEntities * sizeof(CHLTVEntityData) );
+
 	dest->m_iExplicitDeleteSlots = src->m_iExplicitDeleteSlots;
 
 	// FIXME: Copy temp entity data
 }
 
-static void CopyPackedEntities(CFrameSnapshot *dest, const CFrameSnapshot *src)
+// Share the unhooked entities packed in the master snapshot with the client snapshots.
+// Only the valid unhooked entries can hold a packed entity at this point, the hooked tail
+// is packed per client afterwards, and each handle takes all of its references at once.
+static void CopyPackedEntities(CFrameSnapshot **dest, int count, const CFrameSnapshot *src, int numUnhooked)
 {
-	int numEntities = dest->m_nNumEntities;
-	for (int i = 0; i < numEntities; ++i)
+	for (int i = 0; i < numUnhooked; ++i)
 	{
-		auto data = src->m_pEntities[i].m_pPackedData;
-		dest->m_pEntities[i].m_pPackedData = data;
+		const int entindex = src->m_pValidEntities[i];
+		const auto data = src->m_pEntities[entindex].m_pPackedData;
+		if (data == INVALID_PACKED_ENTITY_HANDLE)
+			continue;
 
-		if (data != INVALID_PACKED_ENTITY_HANDLE)
-			framesnapshotmanager->AddEntityReference(data);
+		for (int j = 0; j < count; ++j)
+			dest[j]->m_pEntities[entindex].m_pPackedData = data;
+
+		framesnapshotmanager->AddEntityReference(data, count);
 	}
 
-	if (dest->m_pHLTVEntityData && src->m_pHLTVEntityData)
+	if (src->m_pHLTVEntityData)
 	{
-		Q_memcpy( dest->m_pHLTVEntityData, src->m_pHLTVEntityData, dest->m_nValidEntities * sizeof(CHLTVEntityData) );
+		for (int j = 0; j < count; ++j)
+		{
+			if (dest[j]->m_pHLTVEntityData)
+				Q_memcpy( dest[j]->m_pHLTVEntityData, src->m_pHLTVEntityData, dest[j]->m_nValidEntities * sizeof(CHLTVEntityData) );
+		}
 	}
 }
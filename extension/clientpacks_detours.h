@@ -3,16 +3,27 @@
 
 #include "extension.h"
 
+extern int g_iCurrentClientIndexInLoop;
+
 class ClientPacksDetour
 {
 public:
 	static bool Init(IGameConfig *pGameConf);
 	static void Shutdown();
 	static void Clear();
-	static int GetCurrentClientIndex();
+	// Slot being packed, the client slot or SHARED_PACK_SLOT, -1 outside of the hooked passes.
+	// Inline as every proxy call asks.
+	static int GetCurrentPackSlot()
+	{
+		return g_iCurrentClientIndexInLoop;
+	}
 	static void OnEntityHooked(int entity);
 	static void OnEntityUnhooked(int entity);
 	static void OnClientDisconnected(int client);
+
+	// Snapshot buffer pool counters, hits are allocations served by recycled buffers
+	static int GetPoolHits();
+	static int GetPoolMisses();
 };
 
 #endif
\ No newline at end of file
@@ -31,6 +31,7 @@
 
 #include "extension.h"
 #include "natives.h"
+#include "sendprop_finder.h"
 #include "clientpacks_detours.h"
 #include "sendprop_hookmanager.h"
 
@@ -46,6 +47,7 @@ IServerGameClients * gameclients = nullptr;
 CGlobalVars *gpGlobals = nullptr;
 IBinTools* bintools = nullptr;
 ISDKHooks * sdkhooks = nullptr;
+ISDKTools * sdktools = nullptr;
 ConVar *sv_parallel_packentities = nullptr;
 
 CFrameSnapshotManager* framesnapshotmanager = nullptr;
@@ -78,8 +80,10 @@ bool SendProxyManager::SDK_OnLoad(char *error, size_t maxlen, bool late)
 
 	sharesys->AddDependency(myself, "sdkhooks.ext", true, true);
 	sharesys->AddDependency(myself, "bintools.ext", true, true);
+	sharesys->AddDependency(myself, "sdktools.ext", false, true);
 	
 	sharesys->RegisterLibrary(myself, "sendproxy2");
+	sharesys->AddInterface(myself, this);
 
 	plsys->AddPluginsListener(this);
 	playerhelpers->AddClientListener(this);
@@ -92,6 +96,7 @@ void SendProxyManager::SDK_OnAllLoaded()
 {
 	SM_GET_LATE_IFACE(SDKHOOKS, sdkhooks);
 	SM_GET_LATE_IFACE(BINTOOLS, bintools);
+	SM_GET_LATE_IFACE(SDKTOOLS, sdktools);
 
 	if (sdkhooks)
 	{
@@ -142,6 +147,13 @@ void SendProxyManager::NotifyInterfaceDrop(SMInterface* pInterface)
 {
 	std::string_view name = pInterface->GetInterfaceName();
 
+	// Optional, game rules hooks stop being evaluated without it
+	if (name == SMINTERFACE_SDKTOOLS_NAME)
+	{
+		sdktools = nullptr;
+		return;
+	}
+
 	if (name == SMINTERFACE_SDKHOOKS_NAME)
 	{
 		sdkhooks = nullptr;
@@ -170,6 +182,7 @@ bool SendProxyManager::RegisterConCommandBase(ConCommandBase* pVar)
 
 void SendProxyManager::SDK_OnUnload()
 {
+	g_pSendPropHookManager->ClearClassHooks();
 	g_pSendPropHookManager->Clear();
 	ClientPacksDetour::Shutdown();
 
@@ -211,12 +224,66 @@ void SendProxyManager::OnEntityDestroyed(CBaseEntity* pEnt)
 void SendProxyManager::OnClientDisconnected(int client)
 {
 	g_pSendPropHookManager->UnhookEntityAll(client);
+	g_pSendPropHookManager->OnClientDisconnected(client);
 	ClientPacksDetour::OnClientDisconnected(client);
 }
 
+bool SendProxyManager::HookEntity(IExtension *pOwner, int entity, const char *propname, PropType type, int element,
+	ISendProxyCallback *pCallback, char *error, size_t maxlength)
+{
+	SendProp *pProp = nullptr;
+	int offset = 0;
+
+	if (!UTIL_FindSendProp(pProp, entity, propname, true, type, element, &offset, error, maxlength))
+		return false;
+
+	if (g_pSendPropHookManager->IsEntityHooked(entity, pProp, element, pCallback))
+		return true;
+
+	if (!g_pSendPropHookManager->HookEntity(entity, pProp, offset, element, type, SendProxyExtCallback, pCallback, pOwner))
+	{
+		smutils->Format(error, maxlength, "Too many hooked props");
+		return false;
+	}
+
+	return true;
+}
+
+bool SendProxyManager::UnhookEntity(int entity, const char *propname, int element, ISendProxyCallback *pCallback)
+{
+	SendProp *pProp = nullptr;
+	char error[256];
+
+	if (!UTIL_FindSendProp(pProp, entity, propname, false, PropType::Prop_Max, element, nullptr, error, sizeof(error)))
+		return false;
+
+	if (!g_pSendPropHookManager->IsEntityHooked(entity, pProp, element, pCallback))
+		return false;
+
+	g_pSendPropHookManager->UnhookEntity(entity, pProp, element, pCallback);
+	return true;
+}
+
+bool SendProxyManager::IsEntityHooked(int entity, const char *propname, int element, ISendProxyCallback *pCallback)
+{
+	SendProp *pProp = nullptr;
+	char error[256];
+
+	if (!UTIL_FindSendProp(pProp, entity, propname, false, PropType::Prop_Max, element, nullptr, error, sizeof(error)))
+		return false;
+
+	return g_pSendPropHookManager->IsEntityHooked(entity, pProp, element, pCallback);
+}
+
+void SendProxyManager::UnhookAll(IExtension *pOwner)
+{
+	g_pSendPropHookManager->OnExtentionUnloaded(pOwner);
+}
+
 void SendProxyManager::OnCoreMapEnd()
 {
 	g_pSendPropHookManager->Clear();
+	UTIL_ClearSendPropCache();
 }
 
 bool SendProxyManager::SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlen, bool late)
@@ -228,6 +295,8 @@ bool SendProxyManager::SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxl
 	// }
 
 	GET_V_IFACE_ANY(GetEngineFactory, g_pCVar, ICvar, CVAR_INTERFACE_VERSION);
+	// Optional, only used to skip hooked entities that a client does not see
+	gameents = static_cast<IServerGameEnts *>(ismm->VInterfaceMatch(ismm->GetServerFactory(), INTERFACEVERSION_SERVERGAMEENTS));
 	gpGlobals = ismm->GetCGlobals();
 	
 	GET_CONVAR(sv_parallel_packentities);
@@ -53,7 +53,8 @@ class SendProxyManager :
 	public IPluginsListener,
 	public IConCommandBaseAccessor,
 	public IClientListener,
-	public ISMEntityListener
+	public ISMEntityListener,
+	public ISendProxyManager
 {
 public:
 	bool SDK_OnLoad(char * error, size_t maxlength, bool late) override;
@@ -118,12 +119,21 @@ public: //ISMEntityListener
 
 public: //IConCommandBaseAccessor
 	bool RegisterConCommandBase(ConCommandBase* pVar) override;
+
+public: //ISendProxyManager
+	bool HookEntity(IExtension *pOwner, int entity, const char *propname, PropType type, int element,
+		ISendProxyCallback *pCallback, char *error, size_t maxlength) override;
+	bool UnhookEntity(int entity, const char *propname, int element, ISendProxyCallback *pCallback) override;
+	bool IsEntityHooked(int entity, const char *propname, int element, ISendProxyCallback *pCallback) override;
+	void UnhookAll(IExtension *pOwner) override;
 };
 
 extern SendProxyManager g_SendProxyManager;
 extern ConVar *sv_parallel_packentities;
 extern CFrameSnapshotManager *framesnapshotmanager;
 extern void **g_ppLocalNetworkBackdoor;
+extern IServerGameEnts *gameents;
+extern ISDKTools *sdktools;
 
 CBaseEntity *GetGameRulesProxyEnt();
 
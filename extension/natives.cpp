@@ -30,114 +30,17 @@
  */
 
 #include "natives.h"
+#include "sendprop_finder.h"
 #include "sendprop_hookmanager.h"
+#include <algorithm>
+#include <tuple>
+#include <vector>
 
-static bool IsPropValid(const SendProp *prop, PropType type)
+static void UTIL_FindSendProp(SendProp* &ret, IPluginContext *pContext, int index, const char* propname, bool checkType, PropType type, int element, int *pOffset = nullptr, bool gamerules = false)
 {
-	switch (type)
-	{
-	case PropType::Prop_Int:
-		return prop->GetType() == DPT_Int;
-
-	case PropType::Prop_EHandle:
-		return prop->GetType() == DPT_Int && prop->m_nBits == NUM_NETWORKED_EHANDLE_BITS;
-
-	case PropType::Prop_Float:
-		return prop->GetType() == DPT_Float;
-
-	case PropType::Prop_Vector:
-		return prop->GetType() == DPT_Vector || prop->GetType() == DPT_VectorXY;
-
-	case PropType::Prop_String:
-		return prop->GetType() == DPT_String;
-	}
-
-	return false;
-}
-
-static ServerClass* FindEdictServerClass(edict_t *edict)
-{
-	// BUG: (See https://github.com/alliedmodders/hl2sdk/blob/72b927a0a4ee25c788148e6591ff859d1f81df65/game/server/baseentity.cpp#L403-L413)
-	//   gEntList.AddNetworkableEntity is called right before edict()->m_pNetworkable is set
-	//   which may lead to crashes if user establishes a hook in "OnEntityCreated".
-	//
-	// if (IServerNetworkable *pNetwork = edict->GetNetworkable())
-	// {
-	// 	return pNetwork->GetServerClass();
-	// }
-
-	if (IServerUnknown *pUnk = edict->GetUnknown())
-	{
-		if (IServerNetworkable *pNetwork = pUnk->GetNetworkable())
-			return pNetwork->GetServerClass();
-	}
-
-	if (const char* pClassname = gamehelpers->GetEntityClassname(edict))
-	{
-		return gamehelpers->FindServerClass(pClassname);
-	}
-
-	return nullptr;
-}
-
-void UTIL_FindSendProp(SendProp* &ret, IPluginContext *pContext, int index, const char* propname, bool checkType, PropType type, int element)
-{
-	edict_t *edict = UTIL_EdictOfIndex(index);
-	if (!edict || edict->IsFree())
-		return pContext->ReportError("Invalid edict index (%d)", index);
-
-	ServerClass *sc = FindEdictServerClass(edict);
-	if (!sc)
-		return pContext->ReportError("Cannot find ServerClass for edict (%d)", index);
-
-	sm_sendprop_info_t info;
-	gamehelpers->FindSendPropInfo(sc->GetName(), propname, &info);
-
-	SendProp *pProp = info.prop;
-	if (!pProp)
-		return pContext->ReportError("Could not find prop %s", propname);
-	
-	if (pProp->GetType() == DPT_Array)
-	{
-		pProp = pProp->GetArrayProp();
-		if (!pProp)
-			return pContext->ReportError("Unexpected: Prop %s is an array but has no array prop", propname);
-		
-		if (element < 0 || element >= info.prop->GetNumElements())
-			return pContext->ReportError("Element %d is out of bounds (Prop %s has %d elements)", element, propname, info.prop->GetNumElements());
-	}
-	else if (pProp->GetType() == DPT_DataTable)
-	{
-		SendTable *table = pProp->GetDataTable();
-		if (!table)
-			return pContext->ReportError("Unexpected: Prop %s is a datatable but has no data table", propname);
-
-		if (element < 0 || element >= table->GetNumProps())
-			return pContext->ReportError("Element %d is out of bounds (Prop %s has %d elements)", element, propname, table->GetNumProps());
-
-		pProp = table->GetProp(element);
-	}
-
-	if (checkType && !IsPropValid(pProp, type))
-	{
-		switch (type)
-		{
-			case PropType::Prop_Int: 
-				return pContext->ReportError("Prop %s is not an int!", propname);
-			case PropType::Prop_Float:
-				return pContext->ReportError("Prop %s is not a float!", propname);
-			case PropType::Prop_String:
-				return pContext->ReportError("Prop %s is not a string!", propname);
-			case PropType::Prop_Vector:
-				return pContext->ReportError("Prop %s is not a vector!", propname);
-			case PropType::Prop_EHandle:
-				return pContext->ReportError("Prop %s is not an EHandle!", propname);
-			default:
-				return pContext->ReportError("Unsupported prop type %d", type);
-		}
-	}
-
-	ret = pProp;
+	char error[256];
+	if (!UTIL_FindSendProp(ret, index, propname, checkType, type, element, pOffset, error, sizeof(error), gamerules))
+		pContext->ReportError("%s", error);
 }
 
 static cell_t Native_Hook(IPluginContext *pContext, const cell_t *params)
@@ -151,21 +54,140 @@ static cell_t Native_Hook(IPluginContext *pContext, const cell_t *params)
 
 	char *propname = nullptr;
 	SendProp *pProp = nullptr;
+	int offset = 0;
 
 	int index = params[1];
 	pContext->LocalToString(params[2], &propname);
 	PropType type = static_cast<PropType>(params[3]);
 	IPluginFunction *pFunc = pContext->GetFunctionById(params[4]);
 	int element = params[5];
+	int flags = params[0] >= 6 ? params[6] : 0;
 
-	UTIL_FindSendProp(pProp, pContext, index, propname, true, type, element);
+	UTIL_FindSendProp(pProp, pContext, index, propname, true, type, element, &offset);
 	if (pProp == nullptr)
 		return false;
 	
 	if (g_pSendPropHookManager->IsEntityHooked(index, pProp, element, pFunc))
 		return true;
 
-	return g_pSendPropHookManager->HookEntity(index, pProp, element, type, pFunc);
+	return g_pSendPropHookManager->HookEntity(index, pProp, offset, element, type, SendProxyPluginCallback, pFunc, pFunc->GetParentRuntime(), 0, flags);
+}
+
+static cell_t Native_HookBatch(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 7;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return 0;
+	}
+
+	cell_t *entities, *propnames, *types, *elements;
+	pContext->LocalToPhysAddr(params[1], &entities);
+	int numEntities = params[2];
+	pContext->LocalToPhysAddr(params[3], &propnames);
+	pContext->LocalToPhysAddr(params[4], &types);
+	pContext->LocalToPhysAddr(params[5], &elements);
+	int numProps = params[6];
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[7]);
+	int flags = params[0] >= 8 ? params[8] : 0;
+
+	if (numEntities < 0 || numProps < 0)
+	{
+		pContext->ReportError("Invalid array sizes (%d entities, %d props)", numEntities, numProps);
+		return 0;
+	}
+
+	if (numEntities == 0 || numProps == 0)
+		return 0;
+
+	struct ResolvedProp
+	{
+		SendProp *pProp{nullptr};
+		int offset{0};
+		bool duplicate{false};	// same prop and element as an earlier one of the batch
+	};
+
+	// Props are resolved once per ServerClass, one row of numProps per class met
+	std::vector<ServerClass *> classes;
+	std::vector<ResolvedProp> resolved;
+	std::vector<std::tuple<const SendProp *, int, int>> keys;	// (prop, element, index in the batch)
+	std::vector<bool> alreadyHooked(numProps);
+	char error[256];
+	int count = 0;
+
+	// An entity listed twice is hooked once
+	std::vector<cell_t> indexes(entities, entities + numEntities);
+	std::sort(indexes.begin(), indexes.end());
+	indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+	std::vector<bool> visited(indexes.size());
+
+	for (int i = 0; i < numEntities; ++i)
+	{
+		int index = entities[i];
+
+		size_t slot = std::lower_bound(indexes.begin(), indexes.end(), index) - indexes.begin();
+		if (visited[slot])
+			continue;
+		visited[slot] = true;
+
+		ServerClass *sc = UTIL_FindServerClass(index, error, sizeof(error));
+		if (!sc)
+		{
+			pContext->ReportError("%s", error);
+			return count;
+		}
+
+		size_t row = std::find(classes.begin(), classes.end(), sc) - classes.begin();
+		if (row == classes.size())
+		{
+			classes.push_back(sc);
+			resolved.resize(classes.size() * numProps);
+
+			for (int j = 0; j < numProps; ++j)
+			{
+				// Each entry of a 2D array is offset from its own address
+				char *propname;
+				pContext->LocalToString(params[3] + j * sizeof(cell_t) + propnames[j], &propname);
+
+				ResolvedProp &prop = resolved[row * numProps + j];
+				if (!UTIL_FindClassSendProp(prop.pProp, sc, propname, true, static_cast<PropType>(types[j]), elements[j], &prop.offset, error, sizeof(error)))
+				{
+					pContext->ReportError("%s", error);
+					return count;
+				}
+			}
+
+			// Sorted keys of the row, a prop listed twice is hooked once, where it comes first
+			keys.clear();
+			for (int j = 0; j < numProps; ++j)
+				keys.emplace_back(resolved[row * numProps + j].pProp, elements[j], j);
+			std::sort(keys.begin(), keys.end());
+
+			for (size_t k = 1; k < keys.size(); ++k)
+			{
+				if (std::get<0>(keys[k]) == std::get<0>(keys[k - 1]) && std::get<1>(keys[k]) == std::get<1>(keys[k - 1]))
+					resolved[row * numProps + std::get<2>(keys[k])].duplicate = true;
+			}
+		}
+
+		// Checked against the hooks the entity had before the batch, not against the ones added below
+		const ResolvedProp *props = &resolved[row * numProps];
+		for (int j = 0; j < numProps; ++j)
+			alreadyHooked[j] = !props[j].duplicate && g_pSendPropHookManager->IsEntityHooked(index, props[j].pProp, elements[j], pFunc);
+
+		for (int j = 0; j < numProps; ++j)
+		{
+			if (props[j].duplicate || alreadyHooked[j])
+				continue;
+
+			PropType type = static_cast<PropType>(types[j]);
+			if (g_pSendPropHookManager->HookEntity(index, props[j].pProp, props[j].offset, elements[j], type, SendProxyPluginCallback, pFunc, pFunc->GetParentRuntime(), 0, flags))
+				++count;
+		}
+	}
+
+	return count;
 }
 
 static cell_t Native_Unhook(IPluginContext * pContext, const cell_t * params)
@@ -229,6 +251,13 @@ static cell_t Native_HookGameRules(IPluginContext * pContext, const cell_t * par
 		return false;
 	}
 
+	// Game rules props are read from the game rules object, which SDKTools tracks
+	if (!sdktools)
+	{
+		pContext->ReportError("SDKTools is required to hook game rules props.");
+		return false;
+	}
+
 	CBaseEntity *pGameRulesProxy = GetGameRulesProxyEnt();
 	if (!pGameRulesProxy)
 	{
@@ -238,6 +267,7 @@ static cell_t Native_HookGameRules(IPluginContext * pContext, const cell_t * par
 
 	char *propname = nullptr;
 	SendProp *pProp = nullptr;
+	int offset = 0;
 	int index = gamehelpers->EntityToBCompatRef(pGameRulesProxy);
 
 	pContext->LocalToString(params[1], &propname);
@@ -245,14 +275,14 @@ static cell_t Native_HookGameRules(IPluginContext * pContext, const cell_t * par
 	IPluginFunction *pFunc = pContext->GetFunctionById(params[3]);
 	int element = params[4];
 
-	UTIL_FindSendProp(pProp, pContext, index, propname, true, type, element);
+	UTIL_FindSendProp(pProp, pContext, index, propname, true, type, element, &offset, true);
 	if (pProp == nullptr)
 		return false;
 	
 	if (g_pSendPropHookManager->IsEntityHooked(index, pProp, element, pFunc))
 		return true;
 
-	return g_pSendPropHookManager->HookEntity(index, pProp, element, type, pFunc);
+	return g_pSendPropHookManager->HookEntity(index, pProp, offset, element, type, SendProxyPluginCallback, pFunc, pFunc->GetParentRuntime(), 0, 0, true);
 }
 
 static cell_t Native_UnhookGameRules(IPluginContext * pContext, const cell_t * params)
@@ -323,11 +353,302 @@ static cell_t Native_IsHookedGameRules(IPluginContext * pContext, const cell_t *
 	return g_pSendPropHookManager->IsEntityHooked(index, pProp, element, pFunc);
 }
 
+struct SendPropHandleInfo
+{
+	ServerClass *sc;
+	SendProp *pProp;	// leaf prop
+	int offset;
+	int element;
+};
+
+// Props resolved by SendProxy_FindProp, the handle is the index + 1.
+// ServerClasses live as long as the game, so handles stay valid across maps.
+static std::vector<SendPropHandleInfo> s_PropHandles;
+
+static const SendPropHandleInfo *GetPropHandleInfo(IPluginContext *pContext, cell_t handle)
+{
+	if (handle <= 0 || handle > static_cast<cell_t>(s_PropHandles.size()))
+	{
+		pContext->ReportError("Invalid prop handle (%d)", handle);
+		return nullptr;
+	}
+
+	return &s_PropHandles[handle - 1];
+}
+
+// Checks the entity is of the class the prop was resolved from, offsets differ otherwise
+static bool CheckPropHandleEntity(IPluginContext *pContext, const SendPropHandleInfo *info, int index)
+{
+	char error[256];
+	ServerClass *sc = UTIL_FindServerClass(index, error, sizeof(error));
+	if (!sc)
+	{
+		pContext->ReportError("%s", error);
+		return false;
+	}
+
+	if (sc != info->sc)
+	{
+		pContext->ReportError("Prop %s was found in %s, entity %d is a %s", info->pProp->GetName(), info->sc->GetName(), index, sc->GetName());
+		return false;
+	}
+
+	return true;
+}
+
+static cell_t Native_FindProp(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 3;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return 0;
+	}
+
+	char *classname = nullptr;
+	char *propname = nullptr;
+	pContext->LocalToString(params[1], &classname);
+	pContext->LocalToString(params[2], &propname);
+	int element = params[3];
+
+	ServerClass *sc = gamehelpers->FindServerClass(classname);
+	if (!sc)
+		return 0;
+
+	SendProp *pProp = nullptr;
+	int offset = 0;
+	char error[256];
+	if (!UTIL_FindClassSendProp(pProp, sc, propname, false, PropType::Prop_Max, element, &offset, error, sizeof(error)))
+		return 0;
+
+	auto it = std::find_if(s_PropHandles.begin(), s_PropHandles.end(), [&](const SendPropHandleInfo &info)
+		{ return info.sc == sc && info.pProp == pProp && info.element == element; });
+
+	if (it == s_PropHandles.end())
+		it = s_PropHandles.insert(it, { sc, pProp, offset, element });
+
+	return static_cast<cell_t>(it - s_PropHandles.begin()) + 1;
+}
+
+static cell_t Native_HookProp(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 4;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	int index = params[1];
+	const SendPropHandleInfo *info = GetPropHandleInfo(pContext, params[2]);
+	PropType type = static_cast<PropType>(params[3]);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[4]);
+	int flags = params[0] >= 5 ? params[5] : 0;
+
+	if (!info || !CheckPropHandleEntity(pContext, info, index))
+		return false;
+
+	char error[256];
+	if (!CheckPropType(info->pProp, type, info->pProp->GetName(), error, sizeof(error)))
+	{
+		pContext->ReportError("%s", error);
+		return false;
+	}
+
+	if (g_pSendPropHookManager->IsEntityHooked(index, info->pProp, info->element, pFunc))
+		return true;
+
+	return g_pSendPropHookManager->HookEntity(index, info->pProp, info->offset, info->element, type, SendProxyPluginCallback, pFunc, pFunc->GetParentRuntime(), params[2], flags);
+}
+
+static cell_t Native_UnhookProp(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 3;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	int index = params[1];
+	const SendPropHandleInfo *info = GetPropHandleInfo(pContext, params[2]);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[3]);
+
+	if (!info || !CheckPropHandleEntity(pContext, info, index))
+		return false;
+
+	if (!g_pSendPropHookManager->IsEntityHooked(index, info->pProp, info->element, pFunc))
+		return false;
+
+	g_pSendPropHookManager->UnhookEntity(index, info->pProp, info->element, pFunc);
+	return true;
+}
+
+static cell_t Native_IsHookedProp(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 3;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	int index = params[1];
+	const SendPropHandleInfo *info = GetPropHandleInfo(pContext, params[2]);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[3]);
+
+	if (!info || !CheckPropHandleEntity(pContext, info, index))
+		return false;
+
+	return g_pSendPropHookManager->IsEntityHooked(index, info->pProp, info->element, pFunc);
+}
+
+static ServerClass *UTIL_FindClassSendProp(SendProp* &ret, IPluginContext *pContext, const char *classname, const char *propname, bool checkType, PropType type, int element, int *pOffset = nullptr)
+{
+	ServerClass *sc = gamehelpers->FindServerClass(classname);
+	if (!sc)
+	{
+		pContext->ReportError("Server class \"%s\" not found", classname);
+		return nullptr;
+	}
+
+	char error[256];
+	if (!UTIL_FindClassSendProp(ret, sc, propname, checkType, type, element, pOffset, error, sizeof(error)))
+	{
+		pContext->ReportError("%s", error);
+		return nullptr;
+	}
+
+	return sc;
+}
+
+static cell_t Native_HookClass(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 5;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	char *classname = nullptr;
+	char *propname = nullptr;
+	SendProp *pProp = nullptr;
+	int offset = 0;
+
+	pContext->LocalToString(params[1], &classname);
+	pContext->LocalToString(params[2], &propname);
+	PropType type = static_cast<PropType>(params[3]);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[4]);
+	int element = params[5];
+	int flags = params[0] >= 6 ? params[6] : 0;
+
+	ServerClass *sc = UTIL_FindClassSendProp(pProp, pContext, classname, propname, true, type, element, &offset);
+	if (sc == nullptr)
+		return false;
+
+	if (g_pSendPropHookManager->IsClassHooked(sc, pProp, element, pFunc))
+		return true;
+
+	return g_pSendPropHookManager->HookClass(sc, pProp, offset, element, type, SendProxyPluginCallback, pFunc, pFunc->GetParentRuntime(), flags);
+}
+
+static cell_t Native_UnhookClass(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 4;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	char *classname = nullptr;
+	char *propname = nullptr;
+	SendProp *pProp = nullptr;
+
+	pContext->LocalToString(params[1], &classname);
+	pContext->LocalToString(params[2], &propname);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[3]);
+	int element = params[4];
+
+	ServerClass *sc = UTIL_FindClassSendProp(pProp, pContext, classname, propname, false, PropType::Prop_Max, element);
+	if (sc == nullptr)
+		return false;
+
+	if (!g_pSendPropHookManager->IsClassHooked(sc, pProp, element, pFunc))
+		return false;
+
+	g_pSendPropHookManager->UnhookClass(sc, pProp, element, pFunc);
+	return true;
+}
+
+static cell_t Native_IsHookedClass(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 4;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return false;
+	}
+
+	char *classname = nullptr;
+	char *propname = nullptr;
+	SendProp *pProp = nullptr;
+
+	pContext->LocalToString(params[1], &classname);
+	pContext->LocalToString(params[2], &propname);
+	IPluginFunction *pFunc = pContext->GetFunctionById(params[3]);
+	int element = params[4];
+
+	ServerClass *sc = UTIL_FindClassSendProp(pProp, pContext, classname, propname, false, PropType::Prop_Max, element);
+	if (sc == nullptr)
+		return false;
+
+	return g_pSendPropHookManager->IsClassHooked(sc, pProp, element, pFunc);
+}
+
+static cell_t Native_MarkDirty(IPluginContext *pContext, const cell_t *params)
+{
+	constexpr cell_t PARAM_COUNT = 2;
+	if (params[0] < PARAM_COUNT)
+	{
+		pContext->ReportError("Expected %d params, found %d", PARAM_COUNT, params[0]);
+		return 0;
+	}
+
+	int index = params[1];
+	int client = params[2];
+
+	if (index < 0 || index >= MAX_EDICTS)
+	{
+		pContext->ReportError("Invalid entity index %d", index);
+		return 0;
+	}
+
+	if (client < 0 || client > playerhelpers->GetMaxClients())
+	{
+		pContext->ReportError("Invalid client index %d", client);
+		return 0;
+	}
+
+	g_pSendPropHookManager->MarkEntityDirty(index, client);
+	return 0;
+}
+
 const sp_nativeinfo_t g_MyNatives[] = {
 	{"SendProxy_HookEntity", Native_Hook},
+	{"SendProxy_HookEntityBatch", Native_HookBatch},
 	{"SendProxy_HookGameRules", Native_HookGameRules},
 	{"SendProxy_UnhookEntity", Native_Unhook},
 	{"SendProxy_UnhookGameRules", Native_UnhookGameRules},
 	{"SendProxy_IsHookedEntity", Native_IsHooked},
 	{"SendProxy_IsHookedGameRules", Native_IsHookedGameRules},
-	{nullptr, nullptr}};
\ No newline at end of file
+	{"SendProxy_FindProp", Native_FindProp},
+	{"SendProxy_HookEntityProp", Native_HookProp},
+	{"SendProxy_UnhookEntityProp", Native_UnhookProp},
+	{"SendProxy_IsHookedEntityProp", Native_IsHookedProp},
+	{"SendProxy_HookClass", Native_HookClass},
+	{"SendProxy_UnhookClass", Native_UnhookClass},
+	{"SendProxy_IsHookedClass", Native_IsHookedClass},
+	{"SendProxy_MarkDirty", Native_MarkDirty},
+	{nullptr, nullptr}};
\ No newline at end of file
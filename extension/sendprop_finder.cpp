@@ -0,0 +1,290 @@
+#include "sendprop_finder.h"
+#include "util.h"
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+static bool IsPropValid(const SendProp *prop, PropType type)
+{
+	switch (type)
+	{
+	case PropType::Prop_Int:
+		return prop->GetType() == DPT_Int;
+
+	case PropType::Prop_EHandle:
+		return prop->GetType() == DPT_Int && prop->m_nBits == NUM_NETWORKED_EHANDLE_BITS;
+
+	case PropType::Prop_Float:
+		return prop->GetType() == DPT_Float;
+
+	case PropType::Prop_Vector:
+		return prop->GetType() == DPT_Vector || prop->GetType() == DPT_VectorXY;
+
+	case PropType::Prop_String:
+		return prop->GetType() == DPT_String;
+	}
+
+	return false;
+}
+
+static ServerClass* FindEdictServerClass(edict_t *edict)
+{
+	// BUG: (See https://github.com/alliedmodders/hl2sdk/blob/72b927a0a4ee25c788148e6591ff859d1f81df65/game/server/baseentity.cpp#L403-L413)
+	//   gEntList.AddNetworkableEntity is called right before edict()->m_pNetworkable is set
+	//   which may lead to crashes if user establishes a hook in "OnEntityCreated".
+	//
+	// if (IServerNetworkable *pNetwork = edict->GetNetworkable())
+	// {
+	// 	return pNetwork->GetServerClass();
+	// }
+
+	if (IServerUnknown *pUnk = edict->GetUnknown())
+	{
+		if (IServerNetworkable *pNetwork = pUnk->GetNetworkable())
+			return pNetwork->GetServerClass();
+	}
+
+	if (const char* pClassname = gamehelpers->GetEntityClassname(edict))
+	{
+		return gamehelpers->FindServerClass(pClassname);
+	}
+
+	return nullptr;
+}
+
+ServerClass *UTIL_FindServerClass(int index, char *error, size_t maxlen)
+{
+	edict_t *edict = UTIL_EdictOfIndex(index);
+	if (!edict || edict->IsFree())
+		return smutils->Format(error, maxlen, "Invalid edict index (%d)", index), nullptr;
+
+	ServerClass *sc = FindEdictServerClass(edict);
+	if (!sc)
+		return smutils->Format(error, maxlen, "Cannot find ServerClass for edict (%d)", index), nullptr;
+
+	return sc;
+}
+
+struct SendPropCacheKey
+{
+	const ServerClass *sc;
+	std::string_view name;	// points to the name of the prop found, which lives as long as the class
+	int element;
+
+	bool operator==(const SendPropCacheKey &other) const
+	{
+		return sc == other.sc && element == other.element && name == other.name;
+	}
+};
+
+struct SendPropCacheKeyHash
+{
+	size_t operator()(const SendPropCacheKey &key) const
+	{
+		size_t hash = std::hash<const void *>()(key.sc);
+		hash ^= std::hash<std::string_view>()(key.name) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<int>()(key.element) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+};
+
+struct SendPropCacheEntry
+{
+	SendProp *pProp;	// leaf prop, the element prop for arrays and datatables
+	int offset;			// from the object returned by the last datatable proxy on the way, the entity if none
+	int redirects;		// datatables on the way sent through a proxy of their own
+};
+
+// Resolved props by (ServerClass, prop name, element), failures are not cached
+static std::unordered_map<SendPropCacheKey, SendPropCacheEntry, SendPropCacheKeyHash> s_SendPropCache;
+
+// SendProxy_DataTableToDataTable of the game, which sends a table from the data right at its offset
+static SendTableProxyFn s_fnDefaultDataTableProxy = nullptr;
+
+void UTIL_ClearSendPropCache()
+{
+	s_SendPropCache.clear();
+}
+
+// The proxy lives in the game, every "baseclass" prop of BEGIN_SEND_TABLE is sent through it
+static bool FindDefaultDataTableProxy(SendTable *pTable)
+{
+	for (int i = 0; i < pTable->GetNumProps(); ++i)
+	{
+		SendProp *pProp = pTable->GetProp(i);
+		if (pProp->GetType() != DPT_DataTable || !pProp->GetDataTable())
+			continue;
+
+		if (!strcmp(pProp->GetName(), "baseclass"))
+		{
+			s_fnDefaultDataTableProxy = pProp->GetDataTableProxyFn();
+			return true;
+		}
+
+		if (FindDefaultDataTableProxy(pProp->GetDataTable()))
+			return true;
+	}
+
+	return false;
+}
+
+// Past a proxy of its own, a table is sent from whatever object the proxy returns and offsets start over from it
+static void EnterDataTable(const SendProp *pTableProp, SendPropCacheEntry &entry)
+{
+	if (pTableProp->GetDataTableProxyFn() != s_fnDefaultDataTableProxy)
+	{
+		entry.offset = 0;
+		++entry.redirects;
+	}
+	else
+	{
+		entry.offset += pTableProp->GetOffset();
+	}
+}
+
+// Same walk as UTIL_FindInSendTable of SourceMod, keeping track of the object each table is sent from.
+// On success entry holds the offset of the table the prop was found in.
+static bool FindInSendTable(SendTable *pTable, const char *propname, SendPropCacheEntry &entry)
+{
+	for (int i = 0; i < pTable->GetNumProps(); ++i)
+	{
+		SendProp *pProp = pTable->GetProp(i);
+
+		// Sent by the array prop that follows it and bears the same name
+		if (pProp->IsInsideArray())
+			continue;
+
+		if (pProp->GetName() && !strcmp(pProp->GetName(), propname))
+		{
+			entry.pProp = pProp;
+			return true;
+		}
+
+		if (SendTable *pChild = pProp->GetDataTable())
+		{
+			SendPropCacheEntry child = entry;
+			EnterDataTable(pProp, child);
+
+			if (FindInSendTable(pChild, propname, child))
+			{
+				entry = child;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static bool UTIL_ResolveClassSendProp(SendPropCacheEntry &ret, ServerClass *sc, const char* propname, int element, char *error, size_t maxlen)
+{
+	if (auto it = s_SendPropCache.find({ sc, propname, element }); it != s_SendPropCache.end())
+	{
+		ret = it->second;
+		return true;
+	}
+
+	if (!s_fnDefaultDataTableProxy)
+		FindDefaultDataTableProxy(sc->m_pTable);
+
+	SendPropCacheEntry entry{ nullptr, 0, 0 };
+	if (!FindInSendTable(sc->m_pTable, propname, entry))
+		return smutils->Format(error, maxlen, "Could not find prop %s", propname), false;
+
+	SendProp *pFound = entry.pProp;
+	SendProp *pProp = pFound;
+
+	if (pProp->GetType() == DPT_Array)
+	{
+		pProp = pProp->GetArrayProp();
+		if (!pProp)
+			return smutils->Format(error, maxlen, "Unexpected: Prop %s is an array but has no array prop", propname), false;
+
+		if (element < 0 || element >= pFound->GetNumElements())
+			return smutils->Format(error, maxlen, "Element %d is out of bounds (Prop %s has %d elements)", element, propname, pFound->GetNumElements()), false;
+
+		// As Array_Encode, the elements start at the offset of the array prop, not the one of the array itself
+		entry.offset += pProp->GetOffset() + element * pFound->GetElementStride();
+	}
+	else if (pProp->GetType() == DPT_DataTable)
+	{
+		SendTable *table = pProp->GetDataTable();
+		if (!table)
+			return smutils->Format(error, maxlen, "Unexpected: Prop %s is a datatable but has no data table", propname), false;
+
+		if (element < 0 || element >= table->GetNumProps())
+			return smutils->Format(error, maxlen, "Element %d is out of bounds (Prop %s has %d elements)", element, propname, table->GetNumProps()), false;
+
+		EnterDataTable(pFound, entry);
+		pProp = table->GetProp(element);
+		entry.offset += pProp->GetOffset();
+	}
+	else
+	{
+		entry.offset += pProp->GetOffset();
+	}
+
+	entry.pProp = pProp;
+	s_SendPropCache.emplace(SendPropCacheKey{ sc, pFound->GetName(), element }, entry);
+
+	ret = entry;
+	return true;
+}
+
+bool CheckPropType(const SendProp *pProp, PropType type, const char *propname, char *error, size_t maxlen)
+{
+	if (IsPropValid(pProp, type))
+		return true;
+
+	switch (type)
+	{
+		case PropType::Prop_Int:
+			return smutils->Format(error, maxlen, "Prop %s is not an int!", propname), false;
+		case PropType::Prop_Float:
+			return smutils->Format(error, maxlen, "Prop %s is not a float!", propname), false;
+		case PropType::Prop_String:
+			return smutils->Format(error, maxlen, "Prop %s is not a string!", propname), false;
+		case PropType::Prop_Vector:
+			return smutils->Format(error, maxlen, "Prop %s is not a vector!", propname), false;
+		case PropType::Prop_EHandle:
+			return smutils->Format(error, maxlen, "Prop %s is not an EHandle!", propname), false;
+		default:
+			return smutils->Format(error, maxlen, "Unsupported prop type %d", type), false;
+	}
+}
+
+bool UTIL_FindClassSendProp(SendProp* &ret, ServerClass *sc, const char* propname, bool checkType, PropType type, int element, int *pOffset,
+	char *error, size_t maxlen, bool gamerules)
+{
+	SendPropCacheEntry entry;
+	if (!UTIL_ResolveClassSendProp(entry, sc, propname, element, error, maxlen))
+		return false;
+
+	if (checkType && !CheckPropType(entry.pProp, type, propname, error, maxlen))
+		return false;
+
+	// Game rules props are sent from the game rules object by the data table proxy of the proxy entity
+	const int redirects = gamerules ? 1 : 0;
+	if (pOffset && entry.redirects < redirects)
+		return smutils->Format(error, maxlen, "Prop %s is not sent from the game rules object", propname), false;
+
+	if (pOffset && entry.redirects > redirects)
+		return smutils->Format(error, maxlen, "Prop %s is sent through a data table proxy, its value cannot be read from the %s",
+			propname, gamerules ? "game rules" : "entity"), false;
+
+	ret = entry.pProp;
+	if (pOffset)
+		*pOffset = entry.offset;
+
+	return true;
+}
+
+bool UTIL_FindSendProp(SendProp* &ret, int index, const char* propname, bool checkType, PropType type, int element, int *pOffset,
+	char *error, size_t maxlen, bool gamerules)
+{
+	ServerClass *sc = UTIL_FindServerClass(index, error, maxlen);
+	if (!sc)
+		return false;
+
+	return UTIL_FindClassSendProp(ret, sc, propname, checkType, type, element, pOffset, error, maxlen, gamerules);
+}
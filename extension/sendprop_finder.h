@@ -0,0 +1,26 @@
+#ifndef _SENDPROP_FINDER_H
+#define _SENDPROP_FINDER_H
+
+#include "extension.h"
+
+// Finds the ServerClass of an entity, fills error on failure
+ServerClass *UTIL_FindServerClass(int index, char *error, size_t maxlen);
+
+// Fills error when the prop is not of the type asked for
+bool CheckPropType(const SendProp *pProp, PropType type, const char *propname, char *error, size_t maxlen);
+
+// Finds the prop to hook, the element prop for arrays and datatables, and the offset of its data.
+// Offsets are relative to the entity base, so they hold for every entity of the class. Game rules
+// props are sent from the game rules object, their offset is relative to it.
+// Props whose data cannot be read at an offset, sent through a datatable proxy, fail when an offset is asked for.
+bool UTIL_FindClassSendProp(SendProp* &ret, ServerClass *sc, const char* propname, bool checkType, PropType type, int element, int *pOffset,
+	char *error, size_t maxlen, bool gamerules = false);
+
+// Same as above, from the class of an entity
+bool UTIL_FindSendProp(SendProp* &ret, int index, const char* propname, bool checkType, PropType type, int element, int *pOffset,
+	char *error, size_t maxlen, bool gamerules = false);
+
+// Forgets the props resolved so far, called on map end
+void UTIL_ClearSendPropCache();
+
+#endif
@@ -1,12 +1,24 @@
 #include "sendprop_hookmanager.h"
 #include "clientpacks_detours.h"
+#include "sendproxy_stats.h"
 #include <algorithm>
 
+template <int SLOT>
 void GlobalProxy(const SendProp *pProp, const void *pStructBase, const void *pData, DVariant *pOut, int iElement, int objectID);
 
-SendProxyHook::SendProxyHook(SendProp *pProp, SendVarProxyFn pfnProxy)
+template <size_t... Slots>
+static constexpr std::array<SendVarProxyFn, sizeof...(Slots)> MakeProxyTable(std::index_sequence<Slots...>)
+{
+	return {{ &GlobalProxy<Slots>... }};
+}
+
+// One trampoline per slot, so the proxy knows its hook without any lookup
+static constexpr std::array<SendVarProxyFn, MAX_HOOKED_PROPS> s_ProxyTable = MakeProxyTable(std::make_index_sequence<MAX_HOOKED_PROPS>());
+
+SendProxyHook::SendProxyHook(SendProp *pProp, SendVarProxyFn pfnProxy, int slot)
 {
 	m_pProp = pProp;
+	m_iSlot = slot;
 	m_fnRealProxy = m_pProp->GetProxyFn();
 	m_pProp->SetProxyFn( pfnProxy );
 }
@@ -14,7 +26,127 @@ SendProxyHook::SendProxyHook(SendProp *pProp, SendVarProxyFn pfnProxy)
 SendProxyHook::~SendProxyHook()
 {
 	m_pProp->SetProxyFn( m_fnRealProxy );
-	g_pSendPropHookManager->RemoveHook(m_pProp);
+}
+
+void SendProxyHook::Release()
+{
+	Assert(m_iRefCount > 0);
+	if (--m_iRefCount == 0)
+		g_pSendPropHookManager->RemoveHook(this); // deletes this
+}
+
+bool SendPropOverrideCache::Update(int slot, const ProxyValue *pValue)
+{
+	if (pValue == nullptr)
+	{
+		bool wasOverridden = overridden[slot];
+		overridden[slot] = false;
+		return wasOverridden;
+	}
+
+	if (overridden[slot] && pValue->Equals(GetData(slot)))
+		return false;
+
+	if (IsString() && !strings[slot])
+		strings[slot] = std::make_unique<char[]>(DT_MAX_STRING_BUFFERSIZE);
+
+	overridden[slot] = true;
+	pValue->CopyTo(GetData(slot));
+	return true;
+}
+
+bool SendPropOverrideCache::IsSameOverride(int slotA, int slotB) const
+{
+	if (overridden[slotA] != overridden[slotB])
+		return false;
+
+	if (!overridden[slotA])
+		return true;
+
+	if (IsString())
+		return strcmp(strings[slotA].get(), strings[slotB].get()) == 0;
+
+	return memcmp(&values[slotA], &values[slotB], GetProxyScalarSize(type)) == 0;
+}
+
+static int GetCacheElement(const SendPropHook &hook)
+{
+	return hook.proxy->GetProp()->IsInsideArray() ? hook.element : 0;
+}
+
+static uint64_t MakeCacheKey(const SendProxyHook *proxy, int element)
+{
+	return (static_cast<uint64_t>(proxy->GetSlot()) << 32) | static_cast<uint32_t>(element);
+}
+
+// Binary search as the proxy looks up every prop it encodes, entities can have dozens of hooks
+const SendPropOverrideCache *SendPropEntityInfo::FindCache(const SendProxyHook *proxy, int element) const
+{
+	const uint64_t key = MakeCacheKey(proxy, element);
+	auto it = std::lower_bound(cacheKeys.cbegin(), cacheKeys.cend(), key);
+	if (it == cacheKeys.cend() || *it != key)
+		return nullptr;
+
+	return caches[it - cacheKeys.cbegin()].get();
+}
+
+SendPropOverrideCache *SendPropEntityInfo::FindOrCreateCache(const SendProxyHook *proxy, int element, PropType type)
+{
+	const uint64_t key = MakeCacheKey(proxy, element);
+	auto it = std::lower_bound(cacheKeys.begin(), cacheKeys.end(), key);
+	const auto index = it - cacheKeys.begin();
+	if (it != cacheKeys.end() && *it == key)
+		return caches[index].get();
+
+	cacheKeys.insert(it, key);
+	auto &cache = *caches.emplace(caches.begin() + index, std::make_unique<SendPropOverrideCache>());
+	cache->proxy = proxy;
+	cache->element = element;
+	cache->type = type;
+	return cache.get();
+}
+
+void SendPropEntityInfo::PruneCaches()
+{
+	auto isUsed = [](const SendPropHookList *hooks, const SendPropOverrideCache *cache)
+	{
+		return hooks && std::any_of(hooks->cbegin(), hooks->cend(),
+			[cache](const SendPropHook &hook)
+			{
+				return hook.proxy.get() == cache->proxy && GetCacheElement(hook) == cache->element;
+			});
+	};
+
+	// Keeps both vectors in the same order
+	size_t kept = 0;
+	for (size_t i = 0; i < caches.size(); ++i)
+	{
+		if (!isUsed(&list, caches[i].get()) && !isUsed(classHooks, caches[i].get()))
+			continue;
+
+		cacheKeys[kept] = cacheKeys[i];
+		caches[kept] = std::move(caches[i]);
+		++kept;
+	}
+	cacheKeys.resize(kept);
+	caches.resize(kept);
+}
+
+bool SendPropEntityInfo::AllHooksHave(int flags) const
+{
+	auto hasFlags = [flags](const SendPropHook &hook)
+	{
+		return hook.pCallback == nullptr || (hook.flags & flags) == flags;
+	};
+
+	return std::all_of(list.cbegin(), list.cend(), hasFlags)
+		&& (!classHooks || std::all_of(classHooks->cbegin(), classHooks->cend(), hasFlags));
+}
+
+bool SendPropEntityInfo::HasSameOverrides(int slotA, int slotB) const
+{
+	return std::all_of(caches.cbegin(), caches.cend(),
+		[=](const std::unique_ptr<SendPropOverrideCache> &cache) { return cache->IsSameOverride(slotA, slotB); });
 }
 
 SendPropHookManager::SendPropHookManager()
@@ -23,61 +155,187 @@ SendPropHookManager::SendPropHookManager()
 
 void SendPropHookManager::Clear()
 {
-	m_propHooks.clear();
-	m_entityInfos.clear();
+	for (auto &info : m_entityInfos)
+		info.reset();
+
+	Assert(m_propMap.empty() || IsAnyClassHooked());
+	m_iHookedEntities = 0;
+	m_hookedEntities.reset();
+	m_bPendingPurge = false;
 	ClientPacksDetour::Clear();
 }
 
-void SendPropHookManager::RemoveHook(const SendProp *pProp)
+void SendPropHookManager::ClearClassHooks()
 {
-	m_propHooks.erase(pProp);
+	for (auto &info : m_entityInfos)
+	{
+		if (info)
+			info->classHooks = nullptr;
+	}
+
+	m_classHooks.clear();
+	m_iHookedClasses = 0;
 }
 
-void SendPropHookManager::RemoveEntity(int entity, std::function<bool(const SendPropHook &)> pred)
+void SendPropHookManager::RemoveHook(SendProxyHook *pHook)
 {
-	if (auto&& it = m_entityInfos.find(entity); it != m_entityInfos.end())
-		RemoveEntityAt(it, pred);
+	m_propMap.erase(pHook->GetProp());
+	m_propHooks[pHook->GetSlot()].reset();
 }
 
-SendPropHookManager::SendPropEntityInfoMap::iterator
-SendPropHookManager::RemoveEntityAt(SendPropEntityInfoMap::iterator &it, std::function<bool(const SendPropHook &)> pred)
+template <typename Pred>
+void SendPropHookManager::RemoveEntity(int entity, Pred pred)
 {
-	auto &&[entity, info] = *it;
-	Assert(info != nullptr);
+	SendPropEntityInfo *info = m_entityInfos[entity].get();
+	if (!info)
+		return;
+
+	if (m_iDispatchDepth > 0)
+	{
+		for (SendPropHook &hook : info->list)
+		{
+			if (hook.pCallback != nullptr && pred(hook))
+			{
+				hook.pCallback = nullptr;
+				m_bPendingPurge = true;
+			}
+		}
+		return;
+	}
 
 	info->list.remove_if(pred);
-	if (info->list.empty())
+	if (info->IsEmpty())
 	{
 		OnEntityLeaveHook(entity);
-		return m_entityInfos.erase(it);
+		m_entityInfos[entity].reset();
+		return;
 	}
-	return ++it;
+	info->PruneCaches();
+	info->dirty.set();
 }
 
-bool SendPropHookManager::HookEntity(int entity, SendProp *pProp, int element, PropType type, IPluginFunction *pFunc) noexcept
+template <typename Pred>
+void SendPropHookManager::RemoveClass(int classID, Pred pred)
 {
-	Assert(m_propHooks.find(pProp) == m_propHooks.end() || !m_propHooks[pProp].expired());
+	SendPropHookList *hooks = m_classHooks[classID].get();
+	if (!hooks)
+		return;
 
-	SendPropHook hook;
-	hook.element = element;
-	hook.type = type;
-	hook.fnProcess = SendProxyPluginCallback;
-	hook.pCallback = pFunc;
-	hook.pOwner = pFunc->GetParentRuntime();
-	hook.proxy = m_propHooks[pProp].lock();
+	if (m_iDispatchDepth > 0)
+	{
+		for (SendPropHook &hook : *hooks)
+		{
+			if (hook.pCallback != nullptr && pred(hook))
+			{
+				hook.pCallback = nullptr;
+				m_bPendingPurge = true;
+			}
+		}
+		return;
+	}
+
+	hooks->remove_if(pred);
+	DetachClass(hooks);
+	if (hooks->empty())
+	{
+		m_classHooks[classID].reset();
+		--m_iHookedClasses;
+	}
+}
+
+// Refreshes the entities attached to class hooks that changed, detaching them once the list is empty
+void SendPropHookManager::DetachClass(const SendPropHookList *classHooks)
+{
+	for (int i = 0; i < MAX_EDICTS; ++i)
+	{
+		SendPropEntityInfo *info = m_entityInfos[i].get();
+		if (!info || info->classHooks != classHooks)
+			continue;
+
+		if (classHooks->empty())
+			info->classHooks = nullptr;
+
+		if (info->IsEmpty())
+		{
+			OnEntityLeaveHook(i);
+			m_entityInfos[i].reset();
+			continue;
+		}
+		info->PruneCaches();
+		info->dirty.set();
+	}
+}
+
+void SendPropHookManager::Purge()
+{
+	m_bPendingPurge = false;
+
+	auto isRemoved = [](const SendPropHook &hook) { return hook.pCallback == nullptr; };
+
+	for (int i = 0; i < static_cast<int>(m_classHooks.size()); ++i)
+		RemoveClass(i, isRemoved);
 
-	if (hook.proxy == nullptr)
+	for (int i = 0; i < MAX_EDICTS; ++i)
 	{
-		hook.proxy = std::make_shared<SendProxyHook>(pProp, GlobalProxy);
-		m_propHooks[pProp] = hook.proxy;
+		if (m_entityInfos[i])
+			RemoveEntity(i, isRemoved);
 	}
+}
+
+SendProxyHook *SendPropHookManager::AcquirePropHook(SendProp *pProp)
+{
+	if (auto it = m_propMap.find(pProp); it != m_propMap.end())
+		return it->second;
 
-	if (m_entityInfos.find(entity) == m_entityInfos.end())
+	auto slot = std::find(m_propHooks.begin(), m_propHooks.end(), nullptr);
+	if (slot == m_propHooks.end())
 	{
-		m_entityInfos.emplace(entity, std::make_shared<SendPropEntityInfo>());
+		LogError("Too many hooked props (max %d), cannot hook %s", MAX_HOOKED_PROPS, pProp->GetName());
+		return nullptr;
+	}
+
+	int index = slot - m_propHooks.begin();
+	*slot = std::make_unique<SendProxyHook>(pProp, s_ProxyTable[index], index);
+	m_propMap.emplace(pProp, slot->get());
+	return slot->get();
+}
+
+const SendPropHookList *SendPropHookManager::GetClassHooks(const ServerClass *sc) const
+{
+	if (!sc || sc->m_ClassID < 0 || sc->m_ClassID >= static_cast<int>(m_classHooks.size()))
+		return nullptr;
+
+	return m_classHooks[sc->m_ClassID].get();
+}
+
+bool SendPropHookManager::HookEntity(int entity, SendProp *pProp, int offset, int element, PropType type,
+	SendProxyCallback *fnProcess, void *pCallback, void *pOwner, int propHandle, int flags, bool gamerules) noexcept
+{
+	SendProxyHook *pHook = AcquirePropHook(pProp);
+	if (!pHook)
+		return false;
+
+	SendPropHook hook;
+	hook.offset = offset;
+	hook.element = element;
+	hook.propHandle = propHandle;
+	hook.flags = flags;
+	hook.type = type;
+	hook.gamerules = gamerules;
+	hook.fnProcess = fnProcess;
+	hook.pCallback = pCallback;
+	hook.pOwner = pOwner;
+	hook.proxy = SendProxyHookRef(pHook);
+
+	if (m_entityInfos[entity] == nullptr)
+	{
+		m_entityInfos[entity] = std::make_unique<SendPropEntityInfo>();
 		OnEntityEnterHook(entity);
 	}
-	m_entityInfos.at(entity)->list.emplace_front(std::move(hook));
+	SendPropEntityInfo *info = m_entityInfos[entity].get();
+	info->FindOrCreateCache(pHook, GetCacheElement(hook), hook.type);
+	info->list.emplace_front(std::move(hook));
+	info->dirty.set();
 
 	return true;
 }
@@ -90,106 +348,282 @@ void SendPropHookManager::UnhookEntity(int entity, const SendProp *pProp, int el
 
 void SendPropHookManager::UnhookEntityAll(int entity)
 {
+	// The entity is gone, a new one at this index gets the hooks of its own class
+	if (SendPropEntityInfo *info = m_entityInfos[entity].get(); info && info->classHooks)
+	{
+		info->classHooks = nullptr;
+		if (m_iDispatchDepth > 0)
+			m_bPendingPurge = true;
+	}
+
 	RemoveEntity(entity, [&](const SendPropHook &hook)
 				 { return true; });
 }
 
-void SendPropHookManager::OnPluginUnloaded(IPlugin *plugin)
+bool SendPropHookManager::HookClass(const ServerClass *sc, SendProp *pProp, int offset, int element, PropType type,
+	SendProxyCallback *fnProcess, void *pCallback, void *pOwner, int flags) noexcept
 {
-	for (auto it = m_entityInfos.begin(); it != m_entityInfos.end();)
+	SendProxyHook *pHook = AcquirePropHook(pProp);
+	if (!pHook)
+		return false;
+
+	SendPropHook hook;
+	hook.offset = offset;
+	hook.element = element;
+	hook.flags = flags;
+	hook.type = type;
+	hook.fnProcess = fnProcess;
+	hook.pCallback = pCallback;
+	hook.pOwner = pOwner;
+	hook.proxy = SendProxyHookRef(pHook);
+
+	if (sc->m_ClassID >= static_cast<int>(m_classHooks.size()))
+		m_classHooks.resize(sc->m_ClassID + 1);
+
+	auto &hooks = m_classHooks[sc->m_ClassID];
+	if (hooks == nullptr)
 	{
-		it = RemoveEntityAt(it, [pOwner = plugin->GetRuntime()](const SendPropHook &hook)
-							{ return hook.pOwner == pOwner; });
+		hooks = std::make_unique<SendPropHookList>();
+		++m_iHookedClasses;
 	}
+	hooks->emplace_front(std::move(hook));
+
+	for (auto &info : m_entityInfos)
+	{
+		if (info && info->classHooks == hooks.get())
+			info->dirty.set();
+	}
+
+	return true;
 }
 
-void SendPropHookManager::OnExtentionUnloaded(IExtension *ext)
+void SendPropHookManager::UnhookClass(const ServerClass *sc, const SendProp *pProp, int element, const void *pCallback)
+{
+	if (!GetClassHooks(sc))
+		return;
+
+	RemoveClass(sc->m_ClassID, [&](const SendPropHook &hook)
+				{ return hook.proxy->GetProp() == pProp && hook.element == element && hook.pCallback == pCallback; });
+}
+
+bool SendPropHookManager::IsClassHooked(const ServerClass *sc, const SendProp *pProp, int element, const void *pCallback) const
+{
+	const SendPropHookList *hooks = GetClassHooks(sc);
+	if (hooks == nullptr)
+		return false;
+
+	return std::any_of(hooks->cbegin(), hooks->cend(),
+		[&](const SendPropHook &hook)
+		{
+			return hook.proxy->GetProp() == pProp && hook.element == element && hook.pCallback == pCallback;
+		});
+}
+
+void SendPropHookManager::UpdateEntityClass(int entity, const ServerClass *sc)
 {
-	for (auto it = m_entityInfos.begin(); it != m_entityInfos.end();)
+	const SendPropHookList *classHooks = GetClassHooks(sc);
+
+	SendPropEntityInfo *info = m_entityInfos[entity].get();
+	if (info == nullptr)
 	{
-		it = RemoveEntityAt(it, [pOwner = ext](const SendPropHook &hook)
-							{ return hook.pOwner == pOwner; });
+		if (classHooks == nullptr)
+			return;
+
+		m_entityInfos[entity] = std::make_unique<SendPropEntityInfo>();
+		m_entityInfos[entity]->classHooks = classHooks;
+		OnEntityEnterHook(entity);
+		return;
 	}
+
+	if (info->classHooks == classHooks)
+		return;
+
+	info->classHooks = classHooks;
+	if (info->IsEmpty())
+	{
+		OnEntityLeaveHook(entity);
+		m_entityInfos[entity].reset();
+		return;
+	}
+	info->PruneCaches();
+	info->dirty.set();
 }
 
-std::shared_ptr<SendPropEntityInfo>
-SendPropHookManager::GetEntityHooks(int entity) noexcept
+void SendPropHookManager::OnPluginUnloaded(IPlugin *plugin)
 {
-	if (m_entityInfos.find(entity)!= m_entityInfos.end())
-		return m_entityInfos.at(entity);
+	auto isOwned = [pOwner = plugin->GetRuntime()](const SendPropHook &hook) { return hook.pOwner == pOwner; };
+
+	for (int i = 0; i < static_cast<int>(m_classHooks.size()); ++i)
+		RemoveClass(i, isOwned);
 
-	return nullptr;
+	for (int i = 0; i < MAX_EDICTS; ++i)
+		RemoveEntity(i, isOwned);
 }
 
-std::shared_ptr<SendProxyHook>
-SendPropHookManager::GetPropHook(const SendProp *pProp) noexcept
+void SendPropHookManager::OnExtentionUnloaded(IExtension *ext)
 {
-	if (m_propHooks.find(pProp) != m_propHooks.end())
-		return m_propHooks.at(pProp).lock();
+	auto isOwned = [pOwner = ext](const SendPropHook &hook) { return hook.pOwner == pOwner; };
 
-	return nullptr;
+	for (int i = 0; i < static_cast<int>(m_classHooks.size()); ++i)
+		RemoveClass(i, isOwned);
+
+	for (int i = 0; i < MAX_EDICTS; ++i)
+		RemoveEntity(i, isOwned);
 }
 
-bool SendPropHookManager::IsPropHooked(const SendProp *pProp) const
+void SendPropHookManager::OnClientDisconnected(int client)
 {
-	const auto it = m_propHooks.find(pProp);
-	return it != m_propHooks.end() && !it->second.expired();
+	for (auto &info : m_entityInfos)
+	{
+		if (!info)
+			continue;
+
+		for (auto &cache : info->caches)
+			cache->overridden[client - 1] = false;
+		info->dirty[client - 1] = true;
+	}
 }
 
-bool SendPropHookManager::IsEntityHooked(int entity) const
+void SendPropHookManager::MarkEntityDirty(int entity, int client)
 {
-	const auto it = m_entityInfos.find(entity);
-	return it != m_entityInfos.end();
+	SendPropEntityInfo *info = m_entityInfos[entity].get();
+	if (!info)
+		return;
+
+	if (client == 0)
+	{
+		info->dirty.set();
+		return;
+	}
+
+	// A client-invariant entity is evaluated once for everyone, in the shared slot
+	info->dirty[client - 1] = true;
+	info->dirty[SHARED_PACK_SLOT] = true;
 }
 
-bool SendPropHookManager::IsEntityHooked(int entity, const SendProp *pProp, int element, const IPluginFunction *pFunc) const
+bool SendPropHookManager::IsPropHooked(const SendProp *pProp) const
 {
-	const auto it = m_entityInfos.find(entity);
-	if (it == m_entityInfos.end())
+	return m_propMap.find(pProp) != m_propMap.end();
+}
+
+bool SendPropHookManager::IsEntityHooked(int entity, const SendProp *pProp, int element, const void *pCallback) const
+{
+	const SendPropEntityInfo *info = m_entityInfos[entity].get();
+	if (info == nullptr)
 		return false;
 
-	return std::any_of(it->second->list.cbegin(), it->second->list.cend(),
+	return std::any_of(info->list.cbegin(), info->list.cend(),
 		[&](const SendPropHook &hook)
 		{
 			return hook.proxy->GetProp() == pProp
-				&& hook.pCallback == (void *)pFunc
+				&& hook.pCallback == pCallback
 				&& ((hook.proxy->GetProp()->GetType() != DPT_Array && hook.proxy->GetProp()->GetType() != DPT_DataTable)
 				 || hook.element == element);
 		}
 	);
 }
 
-bool SendPropHookManager::IsAnyEntityHooked() const
-{
-	return m_entityInfos.size() > 0;
-}
-
 void SendPropHookManager::OnEntityEnterHook(int entity)
 {
+	++m_iHookedEntities;
+	m_hookedEntities[entity] = true;
 	ClientPacksDetour::OnEntityHooked(entity);
 }
 
 void SendPropHookManager::OnEntityLeaveHook(int entity)
 {
+	--m_iHookedEntities;
+	m_hookedEntities[entity] = false;
 	ClientPacksDetour::OnEntityUnhooked(entity);
 }
 
-class TailInvoker
+bool SendPropHookManager::EvaluateEntity(int entity, int client)
 {
-public:
-	explicit TailInvoker(std::function<void()> fn) : m_call(fn) {}
-	TailInvoker() = delete;
-	TailInvoker(const TailInvoker &other) = delete;
-	~TailInvoker() { m_call(); }
+	SendPropEntityInfo *pEntHook = m_entityInfos[entity].get();
+	if (!pEntHook)
+		return false;
+
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(entity);
+	if (!pEntity)
+		return false;
+
+	const int slot = client == 0 ? SHARED_PACK_SLOT : client - 1;
+
+	// Nothing the value-driven callbacks depend on changed, the overrides still hold
+	if (!pEntHook->dirty[slot] && pEntHook->AllHooksHave(SendProxyFlag_ValueDriven))
+		return false;
+	pEntHook->dirty[slot] = false;
+
+	for (auto &cache : pEntHook->caches)
+		cache->resolved = false;
+
+	bool changed = false;
+
+	// The proxy entity's data table sends the game rules props from the game rules object
+	const void *pGameRules = nullptr;
+	bool gameRulesResolved = false;
 
-private:
-	std::function<void()> m_call;
-};
+	auto evaluate = [&](const SendPropHook &hook)
+	{
+		if (hook.pCallback == nullptr)
+			return;
+
+		const void *pBase = pEntity;
+		if (hook.gamerules)
+		{
+			if (!gameRulesResolved)
+			{
+				pGameRules = sdktools ? sdktools->GetGameRules() : nullptr;
+				gameRulesResolved = true;
+			}
+
+			// Left out, the real value is sent
+			if (!pGameRules)
+				return;
+			pBase = pGameRules;
+		}
+
+		// The first hook that overrides a (prop, element) wins, as when called from the proxy
+		SendPropOverrideCache *pCache = pEntHook->FindOrCreateCache(hook.proxy.get(), GetCacheElement(hook), hook.type);
+		if (pCache->resolved)
+			return;
+
+		const SendProp *pProp = hook.proxy->GetProp();
+		const void *pData = reinterpret_cast<const uint8_t *>(pBase) + hook.offset;
+		if (!pEntHook->data.Read(hook.type, pData))
+		{
+			LogError("%s: SendProxy report: Unknown prop type (%s).", __func__, pProp->GetName());
+			return;
+		}
 
-// !! MUST BE CALLED IN MAIN THREAD
+		g_SendProxyStats.Increment(StatCounter::CallbacksRun);
+		if (hook.fnProcess(hook.pCallback, pProp, pEntHook->data, hook.element, hook.propHandle, entity, client))
+		{
+			pCache->resolved = true;
+			changed |= pCache->Update(slot, &pEntHook->data);
+		}
+	};
+
+	// Hooks of the entity itself take precedence over the ones of its class
+	std::for_each(pEntHook->list.cbegin(), pEntHook->list.cend(), evaluate);
+	if (pEntHook->classHooks)
+		std::for_each(pEntHook->classHooks->cbegin(), pEntHook->classHooks->cend(), evaluate);
+
+	// Not overridden anymore, the client needs the real value back
+	for (auto &cache : pEntHook->caches)
+	{
+		if (!cache->resolved)
+			changed |= cache->Update(slot, nullptr);
+	}
+
+	return changed;
+}
+
+// Only looks up the results of EvaluateEntity, safe to run on the engine's job threads
+template <int SLOT>
 void GlobalProxy(const SendProp *pProp, const void *pStructBase, const void * pData, DVariant *pOut, int iElement, int objectID)
 {
-	auto pHook = g_pSendPropHookManager->GetPropHook(pProp);
+	SendProxyHook *pHook = g_pSendPropHookManager->GetPropHook(SLOT);
 	Assert(pHook != nullptr);
 	if (!pHook)
 	{
@@ -197,61 +631,22 @@ void GlobalProxy(const SendProp *pProp, const void *pStructBase, const void * pD
 		return;
 	}
 
-	ProxyVariant *pOverride = nullptr;
-	TailInvoker finally(
-		[&, hook = std::move(pHook)]() -> void
-		{
-			if (pOverride) {
-				const void *pNewData = nullptr;
-				std::visit(overloaded {
-					[&pNewData](const auto &arg) { pNewData = &arg; },
-					[&pNewData](const CBaseHandle &arg) { pNewData = &arg; },
-					[&pNewData](const std::string &arg) { pNewData = arg.c_str(); },
-				}, *pOverride);
-
-				hook->CallOriginal(pStructBase, pNewData, pOut, iElement, objectID);
-			} else {
-				hook->CallOriginal(pStructBase, pData, pOut, iElement, objectID);
-			}
-		}
-	);
-
-	std::shared_ptr<SendPropEntityInfo> pEntHook = g_pSendPropHookManager->GetEntityHooks(objectID);
+	const int slot = ClientPacksDetour::GetCurrentPackSlot();
+	const SendPropEntityInfo *pEntHook = slot != -1 ? g_pSendPropHookManager->GetEntityHooks(objectID) : nullptr;
 	if (!pEntHook)
-		return;
+		return pHook->CallOriginal(pStructBase, pData, pOut, iElement, objectID);
 
-	int client = ClientPacksDetour::GetCurrentClientIndex();
-	if (client == -1)
-		return;
+	g_SendProxyStats.Increment(StatCounter::ProxyCalls);
 
-	for (const SendPropHook& hook : pEntHook->list)
-	{
-		if (hook.proxy->GetProp() != pProp)
-			continue;
-		
-		if (pProp->IsInsideArray() && hook.element != iElement)
-			continue;
-		
-		if (hook.type == PropType::Prop_Int) {
-			pEntHook->data = *reinterpret_cast<const int *>(pData);
-		} else if (hook.type == PropType::Prop_Float) {
-			pEntHook->data = *reinterpret_cast<const float *>(pData);
-		} else if (hook.type == PropType::Prop_Vector) {
-			pEntHook->data = *reinterpret_cast<const Vector *>(pData);
-		} else if (hook.type == PropType::Prop_String) {
-			pEntHook->data.emplace<std::string>(reinterpret_cast<const char *>(pData), DT_MAX_STRING_BUFFERSIZE);
-		} else if (hook.type == PropType::Prop_EHandle) {
-			pEntHook->data = *reinterpret_cast<const CBaseHandle *>(pData);
-		} else {
-			LogError("%s: SendProxy report: Unknown prop type (%s).", __func__, pProp->GetName());
-			continue;
-		}
+	const void *pNewData = pData;
 
-		if (hook.fnProcess(hook.pCallback, pProp, pEntHook->data, hook.element, objectID, client))
-		{
-			gamehelpers->EdictOfIndex(objectID)->m_fStateFlags |= FL_EDICT_CHANGED;
-			pOverride = &pEntHook->data;
-			return;
-		}
+	const int element = pProp->IsInsideArray() ? iElement : 0;
+	const SendPropOverrideCache *pCache = pEntHook->FindCache(pHook, element);
+	if (pCache && pCache->overridden[slot])
+	{
+		pNewData = pCache->GetData(slot);
+		g_SendProxyStats.Increment(StatCounter::OverridesApplied);
 	}
-}
\ No newline at end of file
+
+	pHook->CallOriginal(pStructBase, pNewData, pOut, iElement, objectID);
+}
@@ -3,88 +3,224 @@
 
 #include "extension.h"
 #include "sendproxy_callback.h"
-#include "sendproxy_variant.h"
+#include "sendproxy_value.h"
 #include <forward_list>
 #include <memory>
-#include <functional>
 #include <unordered_map>
+#include <array>
+#include <bitset>
+#include <vector>
+#include <utility>
+
+// Max number of distinct SendProps that can be hooked at the same time.
+// Each one owns a slot and a dedicated proxy trampoline that knows its slot index.
+constexpr int MAX_HOOKED_PROPS = 512;
 
 class SendProxyHook
 {
 public:
-	explicit SendProxyHook(SendProp *pProp, SendVarProxyFn pfnProxy);
+	explicit SendProxyHook(SendProp *pProp, SendVarProxyFn pfnProxy, int slot);
 	~SendProxyHook();
 	SendProxyHook(const SendProxyHook &other) = delete;
 
 	const SendProp* GetProp() const { return m_pProp; }
+	int GetSlot() const { return m_iSlot; }
 	void CallOriginal(const void *pStructBase, const void *pData, DVariant *pOut, int iElement, int objectID)
 	{
 		m_fnRealProxy(m_pProp, pStructBase, pData, pOut, iElement, objectID);
 	}
 
+	void AddRef() { ++m_iRefCount; }
+	void Release();
+
 private:
 	SendProp *m_pProp;
 	SendVarProxyFn m_fnRealProxy;
+	int m_iSlot;
+	int m_iRefCount{0};
+};
+
+// Non-atomic intrusive reference to a SendProxyHook, the prop proxy is restored once the last one is gone.
+class SendProxyHookRef
+{
+public:
+	SendProxyHookRef() = default;
+	explicit SendProxyHookRef(SendProxyHook *pHook) : m_pHook(pHook) { if (m_pHook) m_pHook->AddRef(); }
+	SendProxyHookRef(const SendProxyHookRef &other) : SendProxyHookRef(other.m_pHook) {}
+	SendProxyHookRef(SendProxyHookRef &&other) noexcept : m_pHook(std::exchange(other.m_pHook, nullptr)) {}
+	SendProxyHookRef &operator=(SendProxyHookRef other) noexcept { std::swap(m_pHook, other.m_pHook); return *this; }
+	~SendProxyHookRef() { if (m_pHook) m_pHook->Release(); }
+
+	SendProxyHook *get() const { return m_pHook; }
+	SendProxyHook *operator->() const { return m_pHook; }
+	explicit operator bool() const { return m_pHook != nullptr; }
+
+private:
+	SendProxyHook *m_pHook{nullptr};
+};
+
+// Hook flags, shared with plugins
+enum SendProxyFlags : int
+{
+	SendProxyFlag_ClientInvariant = (1 << 0),	// callback returns the same value for every client
+	SendProxyFlag_ValueDriven = (1 << 1),		// callback only needs to run again when the entity changed or is marked dirty
 };
 
 struct SendPropHook
 {
-	std::shared_ptr<SendProxyHook> proxy{nullptr};
-	std::function<SendProxyCallback> fnProcess{nullptr};
-	void *pCallback{nullptr};
+	SendProxyHookRef proxy;
+	SendProxyCallback *fnProcess{nullptr};
+	void *pCallback{nullptr};	// nullptr if removed while dispatching, purged afterwards
 	void *pOwner{nullptr};
+	int offset{0};		// offset of the prop data from the entity base, or from the game rules object
 	int element{-1};
+	int propHandle{0};	// prop handle the hook was made with, 0 if made by name
+	int flags{0};		// SendProxyFlags
+	PropType type{PropType::Prop_Max};
+	bool gamerules{false};	// prop of the game rules, sent by the proxy entity from the game rules object
+};
+
+// Override of a (prop, element) pair for each packing slot, filled before encoding and read by the proxy.
+// Also serves as the last value sent to the client.
+struct SendPropOverrideCache
+{
+	const SendProxyHook *proxy{nullptr};
+	int element{0};
 	PropType type{PropType::Prop_Max};
+	bool resolved{false};	// scratch flag while evaluating
+	std::bitset<MAX_PACK_SLOTS> overridden;
+	std::array<ProxyScalar, MAX_PACK_SLOTS> values;
+	// Instead of values for string props, allocated the first time the slot is overridden
+	std::array<std::unique_ptr<char[]>, MAX_PACK_SLOTS> strings;
+
+	// Override of a packing slot as read by the original proxy, only valid while the slot is overridden
+	const void *GetData(int slot) const { return IsString() ? static_cast<const void *>(strings[slot].get()) : &values[slot]; }
+	void *GetData(int slot) { return IsString() ? static_cast<void *>(strings[slot].get()) : &values[slot]; }
+	bool IsString() const { return type == PropType::Prop_String; }
+
+	// Returns true if the slot is about to receive something else than last time.
+	// pValue is nullptr if the value is no longer overridden.
+	bool Update(int slot, const ProxyValue *pValue);
+
+	// Bitwise comparison, so that slots found equal are encoded the same
+	bool IsSameOverride(int slotA, int slotB) const;
 };
 
+using SendPropHookList = std::forward_list<SendPropHook>;
+
 struct SendPropEntityInfo
 {
-	std::forward_list<SendPropHook> list;
-	ProxyVariant data;
+	SendPropHookList list;
+	const SendPropHookList *classHooks{nullptr};	// hooks of the entity's ServerClass, if any
+	std::vector<uint64_t> cacheKeys;	// sorted (prop slot, element) keys, parallel to caches
+	std::vector<std::unique_ptr<SendPropOverrideCache>> caches;
+	std::bitset<MAX_PACK_SLOTS> dirty;	// slots to evaluate again if all hooks are value-driven
+	ProxyValue data;	// scratch value while evaluating
+
+	SendPropEntityInfo() { dirty.set(); }
+
+	bool IsEmpty() const { return list.empty() && classHooks == nullptr; }
+	// True if every live hook of the entity has the SendProxyFlags
+	bool AllHooksHave(int flags) const;
+	// True if both pack slots receive the same overrides, so they can share one packed entity
+	bool HasSameOverrides(int slotA, int slotB) const;
+
+	const SendPropOverrideCache *FindCache(const SendProxyHook *proxy, int element) const;
+	SendPropOverrideCache *FindOrCreateCache(const SendProxyHook *proxy, int element, PropType type);
+	void PruneCaches();
 };
 
 class SendPropHookManager
 {
 protected:
-	using SendPropHookMap = std::unordered_map<const SendProp *, std::weak_ptr<SendProxyHook>>;
-	using SendPropEntityInfoMap = std::unordered_map<int, std::shared_ptr<SendPropEntityInfo>>;
+	using SendPropHookMap = std::unordered_map<const SendProp *, SendProxyHook *>;
+	using SendPropHookSlots = std::array<std::unique_ptr<SendProxyHook>, MAX_HOOKED_PROPS>;
+	using SendPropEntityInfoSlots = std::array<std::unique_ptr<SendPropEntityInfo>, MAX_EDICTS>;
+	using SendPropClassHookSlots = std::vector<std::unique_ptr<SendPropHookList>>;
 
 public:
 	SendPropHookManager();
 	SendPropHookManager(const SendPropHookManager &other) = delete;
 	SendPropHookManager(SendPropHookManager &&other) = delete;
 
-	bool HookEntity(int entity, SendProp *pProp, int element, PropType type, IPluginFunction *callback) noexcept;
+	// pCallback identifies the hook and is handed to fnProcess, pOwner is the plugin runtime or extension.
+	// Game rules hooks are made on the proxy entity, with an offset from the game rules object.
+	bool HookEntity(int entity, SendProp *pProp, int offset, int element, PropType type,
+		SendProxyCallback *fnProcess, void *pCallback, void *pOwner, int propHandle = 0, int flags = 0, bool gamerules = false) noexcept;
 	void UnhookEntity(int entity, const SendProp *pProp, int element, const void *callback);
 	void UnhookEntityAll(int entity);
-	std::shared_ptr<SendPropEntityInfo> GetEntityHooks(int entity) noexcept;
+
+	// Class hooks apply to every entity of the ServerClass, attached as they enter the snapshot
+	bool HookClass(const ServerClass *sc, SendProp *pProp, int offset, int element, PropType type,
+		SendProxyCallback *fnProcess, void *pCallback, void *pOwner, int flags = 0) noexcept;
+	void UnhookClass(const ServerClass *sc, const SendProp *pProp, int element, const void *pCallback);
+	bool IsClassHooked(const ServerClass *sc, const SendProp *pProp, int element, const void *pCallback) const;
+	bool IsAnyClassHooked() const { return m_iHookedClasses > 0; }
+
+	// Attaches the hooks of its class to an entity in the snapshot, or detaches them if it changed class.
+	void UpdateEntityClass(int entity, const ServerClass *sc);
 
 	void OnPluginUnloaded(IPlugin *plugin);
+	void OnClientDisconnected(int client);
 	void OnExtentionUnloaded(IExtension *ext);
 
-	std::shared_ptr<SendProxyHook> GetPropHook(const SendProp *pProp) noexcept;
-	bool IsPropHooked(const SendProp *pProp) const;
-	bool IsEntityHooked(int entity) const;
-	bool IsEntityHooked(int entity, const SendProp *pProp, int element, const IPluginFunction *pFunc) const;
-	bool IsAnyEntityHooked() const;
+	// Hot path accessors used by the proxy trampolines
+	SendProxyHook *GetPropHook(int slot) const noexcept { return m_propHooks[slot].get(); }
+	SendPropEntityInfo *GetEntityHooks(int entity) const noexcept { return m_entityInfos[entity].get(); }
 
+	bool IsPropHooked(const SendProp *pProp) const;
+	bool IsEntityHooked(int entity) const { return m_hookedEntities[entity]; }
+	const std::bitset<MAX_EDICTS> &GetHookedEntities() const { return m_hookedEntities; }
+	bool IsEntityHooked(int entity, const SendProp *pProp, int element, const void *pCallback) const;
+	bool IsAnyEntityHooked() const { return m_iHookedEntities > 0; }
+
+	// Value-driven hooks of the entity run again for the client, 0 for all clients
+	void MarkEntityDirty(int entity, int client = 0);
+
+	// Runs the callbacks of an entity for a client and stores the overrides for the proxies.
+	// Client 0 evaluates a client-invariant entity once for everyone, into SHARED_PACK_SLOT.
+	// Returns true if the client has to be sent something else than last time.
+	// !! MUST BE CALLED IN MAIN THREAD, while dispatch is locked
+	bool EvaluateEntity(int entity, int client);
+
+	// Hooks removed while locked are only marked and purged on the last unlock,
+	// so that callbacks are free to (un)hook while we iterate the lists.
+	void LockDispatch() { ++m_iDispatchDepth; }
+	void UnlockDispatch() { if (--m_iDispatchDepth == 0 && m_bPendingPurge) Purge(); }
+
+	// Clear keeps class hooks across maps, they are only dropped with ClearClassHooks
 	void Clear();
+	void ClearClassHooks();
 
 protected:
 	friend class SendProxyHook;
-	void RemoveHook(const SendProp *pProp);
+	void RemoveHook(SendProxyHook *pHook);
+
+	SendProxyHook *AcquirePropHook(SendProp *pProp);
+	const SendPropHookList *GetClassHooks(const ServerClass *sc) const;
 
-	void RemoveEntity(int entity, std::function<bool(const SendPropHook &)> pred);
-	SendPropEntityInfoMap::iterator RemoveEntityAt(SendPropEntityInfoMap::iterator &it, std::function<bool(const SendPropHook &)> pred);
+	template <typename Pred>
+	void RemoveEntity(int entity, Pred pred);
+	template <typename Pred>
+	void RemoveClass(int classID, Pred pred);
+	void DetachClass(const SendPropHookList *classHooks);
+	void Purge();
 
 	void OnEntityEnterHook(int entity);
 	void OnEntityLeaveHook(int entity);
 
 private:
-	SendPropHookMap m_propHooks;
-	SendPropEntityInfoMap m_entityInfos;
+	SendPropHookMap m_propMap;
+	SendPropHookSlots m_propHooks;
+	SendPropEntityInfoSlots m_entityInfos;
+	SendPropClassHookSlots m_classHooks;	// by ServerClass::m_ClassID
+	std::bitset<MAX_EDICTS> m_hookedEntities;	// entities with an info, packed per client
+	int m_iHookedEntities{0};
+	int m_iHookedClasses{0};
+	int m_iDispatchDepth{0};
+	bool m_bPendingPurge{false};
 };
 
 extern SendPropHookManager *g_pSendPropHookManager;
 
-#endif
\ No newline at end of file
+#endif
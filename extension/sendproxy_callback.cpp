@@ -1,7 +1,7 @@
 #include "sendproxy_callback.h"
 #include "dt_send.h"
 
-bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyVariant &variant, int element, int entity, int client)
+bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyValue &value, int element, int propHandle, int entity, int client)
 {
 	auto func = static_cast<IPluginFunction *>(callback);
 
@@ -10,22 +10,36 @@ bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyVariant
 	if (gamehelpers->ReferenceToEntity(entity) != GetGameRulesProxyEnt())
 		func->PushCell(entity);
 
-	func->PushString(pProp->GetName());
+	if (propHandle != 0)
+		func->PushCell(propHandle);
+	else
+		func->PushString(pProp->GetName());
 
-	ProxyVariant temp = variant;
+	ProxyValue temp;
+	temp.Assign(value);
 	cell_t iEntity = -1;
 	
-	std::visit(overloaded {
-		[func](int &arg)			{ func->PushCellByRef(reinterpret_cast<cell_t*>(&arg)); },
-		[func](float &arg)			{ func->PushFloatByRef(&arg); },
-		[func](std::string& arg)	{ func->PushStringEx(arg.data(), arg.capacity(), SM_PARAM_STRING_UTF8 | SM_PARAM_STRING_COPY, SM_PARAM_COPYBACK); func->PushCell(arg.capacity()); },
-		[func](Vector &arg)			{ func->PushArray(reinterpret_cast<cell_t*>(&arg), 3, SM_PARAM_COPYBACK); },
-		[func, &iEntity](CBaseHandle &arg) {
-			if (edict_t *edict = gamehelpers->GetHandleEntity(arg))
-				iEntity = gamehelpers->IndexOfEdict(edict);
-			func->PushCellByRef(&iEntity);
-		},
-	}, temp);
+	switch (temp.GetType())
+	{
+	case PropType::Prop_Int:
+		func->PushCellByRef(&temp.As<cell_t>());
+		break;
+	case PropType::Prop_Float:
+		func->PushFloatByRef(&temp.As<float>());
+		break;
+	case PropType::Prop_String:
+		func->PushStringEx(&temp.As<char>(), DT_MAX_STRING_BUFFERSIZE, SM_PARAM_STRING_UTF8 | SM_PARAM_STRING_COPY, SM_PARAM_COPYBACK);
+		func->PushCell(DT_MAX_STRING_BUFFERSIZE);
+		break;
+	case PropType::Prop_Vector:
+		func->PushArray(&temp.As<cell_t>(), 3, SM_PARAM_COPYBACK);
+		break;
+	case PropType::Prop_EHandle:
+		if (edict_t *edict = gamehelpers->GetHandleEntity(temp.As<CBaseHandle>()))
+			iEntity = gamehelpers->IndexOfEdict(edict);
+		func->PushCellByRef(&iEntity);
+		break;
+	}
 
 	func->PushCell(element);
 	func->PushCell(client);
@@ -33,31 +47,33 @@ bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyVariant
 
 	if (result == Pl_Changed)
 	{
-		bool okay = true;
-
-		std::visit(overloaded {
-			[](auto &arg) { },
-
-			[func, iEntity, &okay](CBaseHandle &arg) {
-				if (iEntity == -1) {
-					arg.Term();
-				} else if (edict_t *edict = gamehelpers->EdictOfIndex(iEntity)) {
-					gamehelpers->SetHandleEntity(arg, edict);
-				} else {
-					func->GetParentRuntime()->GetDefaultContext()->BlamePluginError(
-						func, "Unexpected invalid edict index (%d)", iEntity);
-
-					okay = false;
-				}
-			},
-		}, temp);
-
-		if (okay)
+		if (temp.GetType() == PropType::Prop_EHandle)
 		{
-			variant = temp;
-			return true;
+			CBaseHandle &handle = temp.As<CBaseHandle>();
+
+			if (iEntity == -1) {
+				handle.Term();
+			} else if (edict_t *edict = gamehelpers->EdictOfIndex(iEntity)) {
+				gamehelpers->SetHandleEntity(handle, edict);
+			} else {
+				func->GetParentRuntime()->GetDefaultContext()->BlamePluginError(
+					func, "Unexpected invalid edict index (%d)", iEntity);
+
+				return false;
+			}
 		}
+
+		value.Assign(temp);
+		return true;
 	}
 	
 	return false;
 }
+
+bool SendProxyExtCallback(void *callback, const SendProp *pProp, ProxyValue &value, int element, int propHandle, int entity, int client)
+{
+	auto pCallback = static_cast<ISendProxyCallback *>(callback);
+
+	// The value is handed over in place, the callback only writes it when returning true
+	return pCallback->OnSendProxy(entity, pProp, value.GetType(), value.GetData(), element, client);
+}
@@ -2,11 +2,11 @@
 #define _SENDPROXY_CALLBACK_H
 
 #include "extension.h"
-#include "sendproxy_variant.h"
+#include "sendproxy_value.h"
 
-using SendProxyCallback = bool (void *callback, const SendProp *pProp, ProxyVariant &variant, int element, int entity, int client);
+using SendProxyCallback = bool (void *callback, const SendProp *pProp, ProxyValue &value, int element, int propHandle, int entity, int client);
 
-bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyVariant &variant, int element, int entity, int client);
-// bool SendProxyExtCallback(void *callback, const SendProp *pProp, ProxyVariant &variant, int element, int entity, int client);
+bool SendProxyPluginCallback(void *callback, const SendProp *pProp, ProxyValue &value, int element, int propHandle, int entity, int client);
+bool SendProxyExtCallback(void *callback, const SendProp *pProp, ProxyValue &value, int element, int propHandle, int entity, int client);
 
 #endif
\ No newline at end of file
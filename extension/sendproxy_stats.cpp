@@ -0,0 +1,123 @@
+#include "sendproxy_stats.h"
+#include "clientpacks_detours.h"
+#include <algorithm>
+#include <vector>
+
+SendProxyStats g_SendProxyStats;
+
+static const char *s_TimerNames[] = {
+	"snapshot copy",
+	"unhooked pack",
+	"callbacks",
+	"hooked pack",
+};
+
+static const char *s_CounterNames[] = {
+	"proxy calls",
+	"callbacks run",
+	"overrides applied",
+	"state changes forced",
+	"packs shared",
+	"packs skipped",
+};
+
+static_assert(std::size(s_TimerNames) == static_cast<size_t>(StatTimer::Count));
+static_assert(std::size(s_CounterNames) == static_cast<size_t>(StatCounter::Count));
+
+SendProxyStats::ThreadCounters *SendProxyStats::AcquireThreadCounters()
+{
+	const int index = m_iThreadCount.fetch_add(1, std::memory_order_relaxed);
+	return index < MAX_THREADS ? &m_threadCounters[index] : nullptr;
+}
+
+void SendProxyStats::BeginTick()
+{
+	m_current = TickRecord();
+
+	const int numThreads = std::min(m_iThreadCount.load(std::memory_order_relaxed), MAX_THREADS);
+	for (int i = 0; i < numThreads; ++i)
+		m_threadCounters[i].counts.fill(0);
+	for (auto &counter : m_overflow)
+		counter.store(0, std::memory_order_relaxed);
+}
+
+void SendProxyStats::EndTick()
+{
+	const int numThreads = std::min(m_iThreadCount.load(std::memory_order_relaxed), MAX_THREADS);
+	for (size_t i = 0; i < m_overflow.size(); ++i)
+	{
+		m_current.counts[i] = m_overflow[i].load(std::memory_order_relaxed);
+		for (int thread = 0; thread < numThreads; ++thread)
+			m_current.counts[i] += m_threadCounters[thread].counts[i];
+	}
+
+	m_history[m_iHistoryHead] = m_current;
+	m_iHistoryHead = (m_iHistoryHead + 1) % HISTORY_SIZE;
+	if (m_iHistoryCount < HISTORY_SIZE)
+		++m_iHistoryCount;
+}
+
+void SendProxyStats::Reset()
+{
+	m_iHistoryHead = 0;
+	m_iHistoryCount = 0;
+}
+
+// avg, p50, p95 and max of the samples, which get sorted
+template <typename T>
+static void PrintSamples(const char *name, const char *unit, std::vector<T> &samples, double scale)
+{
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (T sample : samples)
+		sum += sample;
+
+	const size_t count = samples.size();
+	META_CONPRINTF("  %-22s avg %10.2f  p50 %10.2f  p95 %10.2f  max %10.2f %s\n",
+		name,
+		sum / count * scale,
+		samples[count / 2] * scale,
+		samples[std::min(count - 1, count * 95 / 100)] * scale,
+		samples.back() * scale,
+		unit);
+}
+
+void SendProxyStats::Print() const
+{
+	META_CONPRINTF("SendProxy client packs, last %d hooked ticks:\n", m_iHistoryCount);
+	if (m_iHistoryCount > 0)
+	{
+		std::vector<double> times(m_iHistoryCount);
+		for (int timer = 0; timer < static_cast<int>(StatTimer::Count); ++timer)
+		{
+			for (int i = 0; i < m_iHistoryCount; ++i)
+				times[i] = m_history[i].times[timer];
+
+			PrintSamples(s_TimerNames[timer], "us", times, 1000000.0);
+		}
+
+		std::vector<int> counts(m_iHistoryCount);
+		for (int counter = 0; counter < static_cast<int>(StatCounter::Count); ++counter)
+		{
+			for (int i = 0; i < m_iHistoryCount; ++i)
+				counts[i] = m_history[i].counts[counter];
+
+			PrintSamples(s_CounterNames[counter], "", counts, 1.0);
+		}
+	}
+
+	META_CONPRINTF("  snapshot buffer pool: %d hits, %d misses\n",
+		ClientPacksDetour::GetPoolHits(), ClientPacksDetour::GetPoolMisses());
+}
+
+CON_COMMAND(sm_sendproxy_stats, "Print SendProxy timings and counters of the last ticks. Pass \"reset\" to clear them.")
+{
+	if (args.ArgC() > 1 && !strcmp(args.Arg(1), "reset"))
+	{
+		g_SendProxyStats.Reset();
+		return;
+	}
+
+	g_SendProxyStats.Print();
+}
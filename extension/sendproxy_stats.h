@@ -0,0 +1,96 @@
+#ifndef _SENDPROXY_STATS_H
+#define _SENDPROXY_STATS_H
+
+#include "extension.h"
+#include <array>
+#include <atomic>
+
+enum class StatTimer
+{
+	SnapshotCopy,	// making and filling the extra client snapshots
+	UnhookedPack,	// packing unhooked entities once for everyone
+	Callbacks,		// running the callbacks of hooked entities
+	HookedPack,		// packing hooked entities for each client
+
+	Count
+};
+
+enum class StatCounter
+{
+	ProxyCalls,			// hooked proxies called while packing hooked entities
+	CallbacksRun,
+	OverridesApplied,	// proxies that sent an overridden value
+	StateChangesForced,	// FL_EDICT_CHANGED set to repack an entity for a client
+	PacksShared,		// hooked entities not packed for a client as another one got the same overrides
+	PacksSkipped,		// hooked entities not evaluated nor packed for a client that does not transmit them
+
+	Count
+};
+
+// Per-tick timings and counters of the client packing, kept for the last ticks.
+// The proxies may count on the engine's job threads, so each thread has its own counters,
+// summed once the tick is packed and the jobs are done.
+class SendProxyStats
+{
+public:
+	static constexpr int HISTORY_SIZE = 256;
+	static constexpr int MAX_THREADS = 32;
+
+	void BeginTick();
+	void EndTick();
+
+	void AddTime(StatTimer timer, double seconds) { m_current.times[static_cast<int>(timer)] += seconds; }
+	void Increment(StatCounter counter, int count = 1)
+	{
+		thread_local ThreadCounters *t_pCounters = AcquireThreadCounters();
+		if (t_pCounters)
+			t_pCounters->counts[static_cast<int>(counter)] += count;
+		else
+			m_overflow[static_cast<int>(counter)].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	void Print() const;
+	void Reset();
+
+private:
+	struct TickRecord
+	{
+		std::array<double, static_cast<int>(StatTimer::Count)> times{};
+		std::array<int, static_cast<int>(StatCounter::Count)> counts{};
+	};
+
+	// Own cache line, so that threads never write to the same one
+	struct alignas(64) ThreadCounters
+	{
+		std::array<int, static_cast<int>(StatCounter::Count)> counts{};
+	};
+
+	// nullptr once MAX_THREADS threads have counted, the others share the atomic overflow counters
+	ThreadCounters *AcquireThreadCounters();
+
+	std::array<ThreadCounters, MAX_THREADS> m_threadCounters{};
+	std::atomic<int> m_iThreadCount{0};
+	std::array<std::atomic<int>, static_cast<int>(StatCounter::Count)> m_overflow{};
+	TickRecord m_current;
+	std::array<TickRecord, HISTORY_SIZE> m_history;
+	int m_iHistoryHead{0};
+	int m_iHistoryCount{0};
+};
+
+extern SendProxyStats g_SendProxyStats;
+
+// Adds the time spent in its scope to a timer
+class StatScopedTimer
+{
+public:
+	explicit StatScopedTimer(StatTimer timer) : m_timer(timer), m_flStart(Plat_FloatTime()) {}
+	~StatScopedTimer() { g_SendProxyStats.AddTime(m_timer, Plat_FloatTime() - m_flStart); }
+
+	StatScopedTimer(const StatScopedTimer &other) = delete;
+
+private:
+	StatTimer m_timer;
+	double m_flStart;
+};
+
+#endif
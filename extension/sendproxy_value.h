@@ -0,0 +1,114 @@
+#ifndef _SENDPROXY_VALUE_H
+#define _SENDPROXY_VALUE_H
+
+#include <cstring>
+#include <cstdint>
+#include "ISendProxy.h"
+#include "dt_send.h"
+#include "mathlib/vector.h"
+#include "basehandle.h"
+
+// Storage of a non-string prop value, laid out as the original proxy reads it
+union ProxyScalar
+{
+	int i;
+	float f;
+	float v[3];
+	uint8_t raw[sizeof(float[3])];
+};
+
+static_assert(sizeof(CBaseHandle) <= sizeof(ProxyScalar));
+static_assert(sizeof(Vector) == sizeof(ProxyScalar));
+
+// Bytes of ProxyScalar used by a type
+inline size_t GetProxyScalarSize(PropType type)
+{
+	switch (type)
+	{
+	case PropType::Prop_Vector:
+		return sizeof(float[3]);
+	case PropType::Prop_EHandle:
+		return sizeof(CBaseHandle);
+	default:
+		return sizeof(int);
+	}
+}
+
+// Value of a hooked prop, strings are stored inline so nothing is ever allocated
+class ProxyValue
+{
+public:
+	PropType GetType() const { return m_type; }
+
+	void *GetData() { return m_data.string; }
+	const void *GetData() const { return m_data.string; }
+
+	template <typename T>
+	T &As() { return *reinterpret_cast<T *>(m_data.string); }
+
+	// Reads the value of a prop from the entity, returns false for unknown types
+	bool Read(PropType type, const void *pData)
+	{
+		m_type = type;
+
+		switch (type)
+		{
+		case PropType::Prop_Int:
+		case PropType::Prop_Float:
+		case PropType::Prop_Vector:
+		case PropType::Prop_EHandle:
+			memcpy(m_data.scalar.raw, pData, GetProxyScalarSize(type));
+			return true;
+		case PropType::Prop_String:
+		{
+			const size_t len = strnlen(static_cast<const char *>(pData), sizeof(m_data.string) - 1);
+			memcpy(m_data.string, pData, len);
+			m_data.string[len] = '\0';
+			return true;
+		}
+		}
+
+		return false;
+	}
+
+	// Copies the value in the layout the original proxy reads it
+	void CopyTo(void *pData) const
+	{
+		if (m_type == PropType::Prop_String)
+			strcpy(static_cast<char *>(pData), m_data.string);
+		else
+			memcpy(pData, m_data.scalar.raw, GetProxyScalarSize(m_type));
+	}
+
+	// Compares with a value stored by CopyTo the way they would be encoded
+	bool Equals(const void *pData) const
+	{
+		switch (m_type)
+		{
+		case PropType::Prop_Float:
+			return m_data.scalar.f == *static_cast<const float *>(pData);
+		case PropType::Prop_Vector:
+			return *reinterpret_cast<const Vector *>(m_data.scalar.v) == *static_cast<const Vector *>(pData);
+		case PropType::Prop_String:
+			return strcmp(m_data.string, static_cast<const char *>(pData)) == 0;
+		default:
+			return memcmp(m_data.scalar.raw, pData, GetProxyScalarSize(m_type)) == 0;
+		}
+	}
+
+	void Assign(const ProxyValue &other)
+	{
+		m_type = other.m_type;
+		other.CopyTo(GetData());
+	}
+
+private:
+	PropType m_type{PropType::Prop_Max};
+	union
+	{
+		ProxyScalar scalar;
+		char string[DT_MAX_STRING_BUFFERSIZE];
+	} m_data;
+};
+
+#endif
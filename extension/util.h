@@ -53,26 +53,46 @@ inline void LogError(const char *format, Args... args)
 	g_pSM->LogError(myself, format, args...);
 }
 
-class ConVarScopedSet
+// Overrides the integer value of a ConVar for a scope by writing the field GetInt() and GetBool() read.
+// Unlike SetValue() nothing is formatted, notified or replicated, so it is only meant for
+// cvars the engine reads while the scope lasts.
+class ConVarScopedInt
 {
 public:
-	explicit ConVarScopedSet(ConVar *cvar, const char *value)
-		: m_cvar(cvar), m_savevalue(m_cvar->GetString())
+	explicit ConVarScopedInt(ConVar *cvar, int value)
+		: m_pValue(&GetData(cvar)->m_nValue), m_savevalue(*m_pValue)
 	{
-		m_cvar->SetValue(value);
+		*m_pValue = value;
 	}
 
-	ConVarScopedSet() = delete;
-	ConVarScopedSet(const ConVarScopedSet &other) = delete;
+	ConVarScopedInt() = delete;
+	ConVarScopedInt(const ConVarScopedInt &other) = delete;
 
-	~ConVarScopedSet()
+	~ConVarScopedInt()
 	{
-		m_cvar->SetValue(m_savevalue.data());
+		*m_pValue = m_savevalue;
 	}
 
 private:
-	ConVar *m_cvar;
-	std::string m_savevalue;
+	// Data members of ConVar as declared in tier1/convar.h, which keeps them private
+	struct ConVarData : public ConCommandBase, public IConVar
+	{
+		ConVar *m_pParent;
+		const char *m_pszDefaultValue;
+		char *m_pszString;
+		int m_StringLength;
+		float m_fValue;
+		int m_nValue;
+	};
+
+	static ConVarData *GetData(ConVar *cvar)
+	{
+		// Values live in the parent, as the getters read them
+		return reinterpret_cast<ConVarData *>(reinterpret_cast<ConVarData *>(cvar)->m_pParent);
+	}
+
+	int *m_pValue;
+	int m_savevalue;
 };
 
 class AutoGameConfig
@@ -236,9 +236,9 @@ public:
 		return ret;
 	}
 
-	inline void AddEntityReference( PackedEntityHandle_t handle )
+	inline void AddEntityReference( PackedEntityHandle_t handle, int count = 1 )
 	{
-		m_PackedEntities[ handle ]->m_ReferenceCount++;
+		m_PackedEntities[ handle ]->m_ReferenceCount += count;
 	}
 
 	static void* s_pfnRemoveEntityReference;
@@ -253,6 +253,29 @@ public:
 		s_callRemoveEntityReference->Execute(&stack, nullptr);
 	}
 
+	// Drops a reference in place while others remain, only the last one goes through
+	// the engine's RemoveEntityReference to free the packed entity.
+	inline void ReleaseEntityReference( PackedEntityHandle_t handle )
+	{
+		auto &refs = m_PackedEntities[ handle ]->m_ReferenceCount;
+		for (int count = refs; count > 1; count = refs)
+		{
+			if (refs.AssignIf(count, count - 1))
+				return;
+		}
+
+		RemoveEntityReference(handle);
+	}
+
+	inline void ReleaseEntityReferences( const PackedEntityHandle_t *handles, int count )
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (handles[i] != INVALID_PACKED_ENTITY_HANDLE)
+				ReleaseEntityReference(handles[i]);
+		}
+	}
+
 public:
 	uint32_t pad[21];
 
@@ -295,4 +318,8 @@ extern CFrameSnapshotManager* framesnapshotmanager;
 
 constexpr int MAXPLAYERS = SM_MAXPLAYERS;
 
+// Packing slots are the client slots, plus one for entities packed once for all clients
+constexpr int SHARED_PACK_SLOT = MAXPLAYERS;
+constexpr int MAX_PACK_SLOTS = MAXPLAYERS + 1;
+
 #endif
\ No newline at end of file